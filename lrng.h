@@ -21,12 +21,50 @@
 
 #include <linux/types.h>
 
+/*
+ * Version of struct lrng_drng_caps. A backend sets the version its capability
+ * descriptor was written for, the LRNG ignores fields added in later versions.
+ *
+ * Version 1: chunk_size, max_reqsize, flags
+ */
+#define LRNG_DRNG_CAPS_VERSION		1
+
+/* Independent DRNG instances can generate concurrently without contention */
+#define LRNG_DRNG_CAP_PARALLEL		(1 << 0)
+/* Generate operation uses FPU/SIMD -- never invoked from interrupt context */
+#define LRNG_DRNG_CAP_FPU		(1 << 1)
+/* Seeding is expensive compared to generating one chunk */
+#define LRNG_DRNG_CAP_SEED_EXPENSIVE	(1 << 2)
+
+/**
+ * struct lrng_drng_caps - capability hints of a DRNG backend
+ * @version:		LRNG_DRNG_CAPS_VERSION the descriptor was written for
+ * @chunk_size:		Preferred generate granularity in bytes, requests are
+ *			split at multiples of it (0 = any)
+ * @max_reqsize:	Maximum number of bytes generated with one call of the
+ *			generate helpers (bounded by the LRNG to 4096 ... 65536
+ *			bytes, 0 = 4096)
+ * @flags:		LRNG_DRNG_CAP_* flags
+ *
+ * A backend without capability descriptor is treated as LRNG_DRNG_CAP_PARALLEL
+ * with any chunk size and a maximum request size of 4096 bytes.
+ */
+struct lrng_drng_caps {
+	u32 version;
+	u32 chunk_size;
+	u32 max_reqsize;
+	u32 flags;
+};
+
 /**
  * struct lrng_crypto_cb - cryptographic callback functions
  * @lrng_drng_name		Name of DRNG
  * @lrng_hash_name		Name of Hash used for reading entropy pool
  * @lrng_drng_alloc:		Allocate DRNG -- the provided integer should be
  *				used for sanity checks.
+ *				node: NUMA node the DRNG is used on and its
+ *				      memory should be allocated on, or
+ *				      NUMA_NO_NODE
  *				return: allocated data structure or PTR_ERR on
  *					error
  * @lrng_drng_dealloc:		Deallocate DRNG
@@ -42,6 +80,8 @@
  *				    data bit.
  *				    return: generated number of bytes,
  *					    < 0 on error
+ * @lrng_drng_caps:		Optional: capabilities of the DRNG, see
+ *				struct lrng_drng_caps
  * @lrng_hash_alloc:		Allocate the hash for reading the entropy pool
  *				return: allocated data structure (NULL is
  *					success too) or ERR_PTR on error
@@ -59,12 +99,13 @@
 struct lrng_crypto_cb {
 	const char *(*lrng_drng_name)(void);
 	const char *(*lrng_hash_name)(void);
-	void *(*lrng_drng_alloc)(u32 sec_strength);
+	void *(*lrng_drng_alloc)(u32 sec_strength, int node);
 	void (*lrng_drng_dealloc)(void *drng);
 	int (*lrng_drng_seed_helper)(void *drng, const u8 *inbuf, u32 inbuflen);
 	int (*lrng_drng_generate_helper)(void *drng, u8 *outbuf, u32 outbuflen);
 	int (*lrng_drng_generate_helper_full)(void *drng, u8 *outbuf,
 					      u32 outbuflen);
+	const struct lrng_drng_caps *lrng_drng_caps;
 	void *(*lrng_hash_alloc)(const u8 *key, u32 keylen);
 	void (*lrng_hash_dealloc)(void *hash);
 	u32 (*lrng_hash_digestsize)(void *hash);
@@ -74,6 +115,8 @@ struct lrng_crypto_cb {
 
 /* Register cryptographic backend */
 int lrng_set_drng_cb(const struct lrng_crypto_cb *cb);
+/* Deregister cryptographic backend */
+void lrng_unset_drng_cb(const struct lrng_crypto_cb *cb);
 
 /* Default DRNG implementation */
 extern struct chacha20_state primary_chacha20;
@@ -24,23 +24,39 @@
 
 #include <linux/preempt.h>
 #include <asm/irq_regs.h>
+#include <crypto/rng.h>
+#include <linux/cgroup.h>
 #include <linux/cryptohash.h>
+#include <linux/cpu.h>
+#include <linux/cpuhotplug.h>
 #include <linux/fips.h>
 #include <linux/fs.h>
+#include <linux/hashtable.h>
 #include <linux/init.h>
+#include <linux/irq_work.h>
+#include <linux/kref.h>
 #include <linux/kthread.h>
 #include <linux/lrng.h>
+#include <linux/math64.h>
+#include <linux/memory.h>
 #include <linux/module.h>
+#include <linux/nodemask.h>
+#include <linux/nsproxy.h>
 #include <linux/percpu.h>
 #include <linux/poll.h>
 #include <linux/random.h>
+#include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/syscalls.h>
+#include <linux/timer.h>
 #include <linux/timex.h>
+#include <linux/user_namespace.h>
 #include <linux/utsname.h>
 #include <linux/workqueue.h>
 #include <linux/uuid.h>
+#include <net/net_namespace.h>
+#include <trace/events/sched.h>
 
 /* Security strength of LRNG -- this must match DRNG security strength */
 #define LRNG_DRNG_SECURITY_STRENGTH_BYTES 32
@@ -65,6 +81,7 @@ struct lrng_pdrng {
 	bool pdrng_min_seeded;			/* Is DRNG minimally seeded? */
 	u32 pdrng_entropy_bits;			/* DRNG entropy level */
 	struct work_struct lrng_seed_work;	/* (re)seed work queue */
+	u64 lrng_seed_work_queued;		/* Time seed work was queued */
 	struct mutex lock;
 };
 
@@ -72,10 +89,18 @@ struct lrng_pdrng {
 struct lrng_sdrng {
 	void *sdrng;				/* DRNG handle */
 	const struct lrng_crypto_cb *crypto_cb;	/* Crypto callbacks */
-	atomic_t requests;			/* Number of DRNG requests */
+	unsigned long bytes;			/* Bytes generated since seeding */
 	unsigned long last_seeded;		/* Last time it was seeded */
 	bool fully_seeded;			/* Is DRNG fully seeded? */
 	bool force_reseed;			/* Force a reseed */
+	bool group_drng;			/* DRNG of a group of callers */
+	bool retired;				/* NUMA node went offline */
+	int node;				/* NUMA node served by DRNG */
+	struct timer_list reseed_timer;		/* Scheduled reseed deadline */
+	struct work_struct reseed_work;		/* Reseed outside read path */
+	u64 reseed_work_queued;			/* Time reseed work was queued */
+	atomic_t small_waiters;			/* Queued small requests */
+	wait_queue_head_t small_wait;		/* Large requests yielding */
 	struct mutex lock;
 	spinlock_t spin_lock;
 };
@@ -89,15 +114,50 @@ struct lrng_sdrng {
 #define LRNG_DRNG_MAX_REQSIZE (1<<12)
 
 /*
- * SP800-90A defines a maximum number of requests between reseeds of 1<<48.
- * The given value is considered a much safer margin, balancing requests for
- * frequent reseeds with the need to conserve entropy. This value MUST NOT be
- * larger than INT_MAX because it is used in an atomic_t. This applies to
- * secondary DRNG.
+ * Upper limit of the request size a DRNG backend may ask for with its
+ * capability hints -- the SP800-90A maximum of 1<<16 bytes. The
+ * reseed budget is accounted in bytes regardless of the request size used.
+ */
+#define LRNG_DRNG_MAX_REQSIZE_BULK (1<<16)
+
+/*
+ * Requests up to this size are considered latency sensitive. Larger requests
+ * let queued small requests pass between their LRNG_DRNG_MAX_REQSIZE chunks.
+ *
+ * This value is allowed to be changed.
+ */
+#define LRNG_DRNG_SMALL_REQSIZE 256
+
+/*
+ * Default number of bytes a secondary DRNG may generate between reseeds.
+ * SP800-90A allows 1<<48 requests of up to 1<<16 bytes each. The given value
+ * is considered a much safer margin, balancing requests for frequent reseeds
+ * with the need to conserve entropy. Each request is charged with at least
+ * LRNG_DRNG_SECURITY_STRENGTH_BYTES, i.e. small requests trigger a reseed
+ * after 1<<20 requests as with the former request counter. The budget of
+ * each DRNG tier can be raised at runtime with the drng_*_reseed_bytes
+ * sysctls.
  *
  * This value is allowed to be changed.
  */
-#define LRNG_DRNG_RESEED_THRESH (1<<20)
+#define LRNG_DRNG_RESEED_BYTES (1UL<<25)
+
+/* Default number of seconds between reseeds of a secondary DRNG */
+#define LRNG_DRNG_RESEED_SECS 600
+
+/*
+ * Tiers of secondary DRNGs with their own reseed budget:
+ * the initial DRNG serving all requests during boot until the per-NUMA node
+ * DRNGs are allocated, the DRNGs of the NUMA nodes including the initial DRNG
+ * serving the first node afterwards and the group DRNGs, and the DRNG for
+ * atomic contexts.
+ */
+enum lrng_sdrng_tier {
+	LRNG_SDRNG_TIER_INIT,
+	LRNG_SDRNG_TIER_NODE,
+	LRNG_SDRNG_TIER_ATOMIC,
+	LRNG_SDRNG_TIER_MAX
+};
 
 /* Status information about IRQ noise source */
 struct lrng_irq_info {
@@ -165,7 +225,10 @@ struct lrng_pool {
 #define LRNG_POOL_WORD_BITS (LRNG_POOL_WORD_BYTES * 8)
 	atomic_t pool[LRNG_POOL_SIZE];	/* Pool */
 	atomic_t pool_ptr;	/* Ptr into pool for next IRQ word injection */
+#define LRNG_POOL_PTR_STRIDE 67
 	atomic_t input_rotate;		/* rotate for LFSR */
+	u32 read_ptr;		/* pool_ptr at last pool read */
+	u32 read_events_back;	/* IRQs left unused by last pool read */
 	u32 numa_drngs;			/* Number of online DRNGs */
 	bool all_online_numa_node_seeded;	/* All NUMA DRNGs seeded? */
 	void *lrng_hash;
@@ -221,21 +284,57 @@ static struct lrng_pdrng lrng_pdrng = {
 	.lock		= __MUTEX_INITIALIZER(lrng_pdrng.lock)
 };
 
+static void lrng_sdrng_reseed_timer(struct timer_list *t);
+static void lrng_sdrng_reseed_work(struct work_struct *work);
 static struct lrng_sdrng lrng_sdrng_init = {
 	.sdrng		= &secondary_chacha20,
 	.crypto_cb	= &lrng_cc20_crypto_cb,
+	.node		= NUMA_NO_NODE,
+	.force_reseed	= true,
+	.reseed_timer	= __TIMER_INITIALIZER(lrng_sdrng_reseed_timer, 0),
+	.reseed_work	= __WORK_INITIALIZER(lrng_sdrng_init.reseed_work,
+					     lrng_sdrng_reseed_work),
+	.small_wait	= __WAIT_QUEUE_HEAD_INITIALIZER(
+					lrng_sdrng_init.small_wait),
 	.lock		= __MUTEX_INITIALIZER(lrng_sdrng_init.lock),
 	.spin_lock	= __SPIN_LOCK_UNLOCKED(lrng_sdrng_init.spin_lock)
 };
 static struct lrng_sdrng **lrng_sdrng __read_mostly = NULL;
 static DEFINE_MUTEX(lrng_crypto_cb_update);
 
+/*
+ * Nodes whose secondary DRNG is in service. A DRNG of a node that went
+ * offline is retired but not freed as a reader may still hold a reference.
+ * Updated under the lrng_crypto_cb_update lock.
+ */
+static nodemask_t lrng_sdrng_nodes = NODE_MASK_NONE;
+
+static void lrng_sdrng_atomic_reseed_work(struct work_struct *work);
 static struct lrng_sdrng lrng_sdrng_atomic = {
 	.sdrng		= &secondary_chacha20,
 	.crypto_cb	= &lrng_cc20_crypto_cb,
+	.node		= NUMA_NO_NODE,
+	.force_reseed	= true,
+	.reseed_work	= __WORK_INITIALIZER(lrng_sdrng_atomic.reseed_work,
+					     lrng_sdrng_atomic_reseed_work),
 	.spin_lock	= __SPIN_LOCK_UNLOCKED(lrng_sdrng_atomic.spin_lock)
 };
 
+/*
+ * Seed distribution tree: the primary DRNG seeds the secondary DRNGs of the
+ * NUMA nodes which in turn seed the leaf DRNGs, i.e. the atomic DRNG and the
+ * per-CPU batched entropy. Leaf DRNGs never pull from the primary DRNG. The
+ * seeds delivered by each level are accounted to show that the load on the
+ * primary DRNG scales with the number of nodes and not with the number of
+ * CPUs.
+ */
+enum lrng_seed_level {
+	LRNG_SEED_LEVEL_PRIMARY,	/* Seeds from primary to node DRNGs */
+	LRNG_SEED_LEVEL_NODE,		/* Seeds from node to leaf DRNGs */
+	LRNG_SEED_LEVEL_MAX
+};
+static atomic64_t lrng_seed_level_seeds[LRNG_SEED_LEVEL_MAX];
+
 static struct lrng_pool lrng_pool __aligned(LRNG_KCAPI_ALIGN) = {
 	.numa_drngs = 1,
 	.irq_info =
@@ -269,12 +368,37 @@ static u32 lrng_write_wakeup_bits = LRNG_EMERG_ENTROPY +
 static u32 lrng_read_wakeup_bits = LRNG_POOL_WORD_BITS * 2;
 
 /*
- * Maximum number of seconds between DRNG reseed intervals of the secondary
- * DRNG. Note, this is enforced with the next request of random numbers from
- * the secondary DRNG. Setting this value to zero implies a reseeding attempt
- * before every generated random number.
+ * Reseed budget of the secondary DRNGs per tier: the number of bytes a DRNG
+ * may generate and the maximum number of seconds between reseeds. Note, the
+ * time is enforced by the reseed timer of the secondary DRNG and with the
+ * next request of random numbers from the secondary DRNG. Setting either
+ * value to zero implies a reseeding attempt before every generated random
+ * number.
+ */
+static unsigned long lrng_sdrng_reseed_bytes[LRNG_SDRNG_TIER_MAX] = {
+	[0 ... LRNG_SDRNG_TIER_MAX - 1] = LRNG_DRNG_RESEED_BYTES
+};
+static int lrng_sdrng_reseed_secs[LRNG_SDRNG_TIER_MAX] = {
+	[0 ... LRNG_SDRNG_TIER_MAX - 1] = LRNG_DRNG_RESEED_SECS
+};
+
+/*
+ * Workqueue executing the seeding operations of the LRNG. It is unbound to
+ * allow the work to execute on the NUMA node of the DRNG it seeds and is
+ * independent of the load of the system workqueues.
+ */
+static struct workqueue_struct *lrng_wq __read_mostly;
+
+/*
+ * Latency target between queuing a seeding work item and its execution.
+ * Exceeding the target is reported, the maximum observed latency is
+ * provided via the sysctl seed_latency_max_usecs.
  */
-static int lrng_sdrng_reseed_max_time = 600;
+static u32 seed_latency_target_ms = 10;
+module_param(seed_latency_target_ms, uint, 0644);
+MODULE_PARM_DESC(seed_latency_target_ms, "Latency target in milliseconds for "
+					 "executing queued seeding operations");
+static unsigned long lrng_seed_latency_max_us;
 
 /********************************** Helper ***********************************/
 
@@ -328,6 +452,60 @@ static inline bool lrng_have_entropy_full(void)
 					LRNG_DRNG_SECURITY_STRENGTH_BITS);
 }
 
+/*
+ * Queue a seeding work item on the LRNG workqueue close to the given NUMA
+ * node and record the time of queuing.
+ */
+static void lrng_queue_work_node(int node, struct work_struct *work,
+				 u64 *queued)
+{
+	struct workqueue_struct *wq = lrng_wq ? lrng_wq : system_unbound_wq;
+
+	if (work_pending(work))
+		return;
+
+	WRITE_ONCE(*queued, ktime_get_ns());
+	queue_work_node(node, wq, work);
+}
+
+/* Account the queuing latency of an executing seeding work item */
+static void lrng_seed_latency(u64 queued)
+{
+	unsigned long latency_us =
+		(unsigned long)div_u64(ktime_get_ns() - queued,
+				       NSEC_PER_USEC);
+
+	if (latency_us > lrng_seed_latency_max_us)
+		lrng_seed_latency_max_us = latency_us;
+
+	if (latency_us > seed_latency_target_ms * USEC_PER_MSEC)
+		pr_warn_ratelimited("seeding operation executed %lu us after "
+				    "queuing (target %u ms)\n", latency_us,
+				    seed_latency_target_ms);
+}
+
+/*
+ * NUMA node of the secondary DRNG the interrupt-triggered seed work will seed
+ * next.
+ */
+static int lrng_sdrng_unseeded_node(void)
+{
+	struct lrng_sdrng **sdrngs = READ_ONCE(lrng_sdrng);
+	int node;
+
+	if (!sdrngs)
+		return NUMA_NO_NODE;
+
+	for_each_node_mask(node, lrng_sdrng_nodes) {
+		struct lrng_sdrng *sdrng = READ_ONCE(sdrngs[node]);
+
+		if (sdrng && !sdrng->fully_seeded)
+			return node;
+	}
+
+	return NUMA_NO_NODE;
+}
+
 /**
  * Ping all kernel internal callers waiting until the DRNG is fully
  * seeded that the DRNG is now fully seeded.
@@ -395,6 +573,17 @@ struct rand_data *jent_lrng_entropy_collector(void);
 int jent_read_entropy(struct rand_data *ec, unsigned char *data,
 		      unsigned int len);
 static struct rand_data *lrng_jent_state;
+
+/* Entropy statement for outbuflen bytes of a collector */
+static inline u32 lrng_jent_entropy(u32 ent_bits, unsigned int outbuflen)
+{
+	if (outbuflen != LRNG_DRNG_SECURITY_STRENGTH_BYTES)
+		ent_bits = (ent_bits * outbuflen<<3) /
+			   LRNG_DRNG_SECURITY_STRENGTH_BITS;
+	/* Cap entropy to buffer size in bits */
+	return min_t(u32, ent_bits, outbuflen<<3);
+}
+
 static u32 lrng_get_jent(u8 *outbuf, unsigned int outbuflen)
 {
 	int ret;
@@ -426,19 +615,273 @@ static u32 lrng_get_jent(u8 *outbuf, unsigned int outbuflen)
 		return 0;
 	}
 
-	/* Obtain entropy statement */
-	if (outbuflen != LRNG_DRNG_SECURITY_STRENGTH_BYTES)
-		ent_bits = (ent_bits * outbuflen<<3) /
-			   LRNG_DRNG_SECURITY_STRENGTH_BITS;
-	/* Cap entropy to buffer size in bits */
-	ent_bits = min_t(u32, ent_bits, outbuflen<<3);
+	ent_bits = lrng_jent_entropy(ent_bits, outbuflen);
 	pr_debug("obtained %u bits of entropy from Jitter RNG noise source\n",
 		 ent_bits);
 
 	return ent_bits;
 }
+
+/*
+ * Parallel Jitter RNG collection during boot
+ *
+ * Until the primary DRNG is fully seeded, the Jitter RNG output of up to
+ * jent_parallel collectors is gathered in parallel: the static collector runs
+ * on the local CPU while independent instances of the jitterentropy_rng
+ * kernel crypto API RNG run on other online CPUs. Each collector is credited
+ * on its own. Once the primary DRNG is fully seeded, the additional instances
+ * are released and only the static collector is used.
+ */
+#define LRNG_JENT_PARALLEL_MAX		8
+
+static u32 jent_parallel = 0;
+module_param(jent_parallel, uint, 0444);
+MODULE_PARM_DESC(jent_parallel, "Number of Jitter RNG collectors running in "
+				"parallel until the primary DRNG is fully "
+				"seeded (0 and 1 disable parallel collection)");
+
+struct lrng_jent_collector {
+	struct work_struct work;
+	struct crypto_rng *rng;
+	u8 *outbuf;
+	u32 outbuflen;
+	int ret;
+};
+
+/* Additional collectors - only used by one lrng_get_jent_parallel at a time */
+static struct lrng_jent_collector lrng_jent_collectors[LRNG_JENT_PARALLEL_MAX - 1];
+static u32 lrng_jent_collectors_num;
+static bool lrng_jent_parallel_done;
+/* No collector allocation attempt before this time in jiffies */
+static unsigned long lrng_jent_collectors_retry;
+static bool lrng_jent_collectors_backoff;
+/*
+ * Per-CPU queue for the collectors - its WQ_MEM_RECLAIM allows flushing them
+ * from the harvest which runs on the WQ_MEM_RECLAIM lrng_wq.
+ */
+static struct workqueue_struct *lrng_jent_wq __read_mostly;
+
+static void lrng_jent_collector_work(struct work_struct *work)
+{
+	struct lrng_jent_collector *col =
+		container_of(work, struct lrng_jent_collector, work);
+
+	col->ret = crypto_rng_get_bytes(col->rng, col->outbuf, col->outbuflen);
+}
+
+static void lrng_jent_collectors_free(void)
+{
+	u32 i;
+
+	for (i = 0; i < lrng_jent_collectors_num; i++)
+		crypto_free_rng(lrng_jent_collectors[i].rng);
+	lrng_jent_collectors_num = 0;
+}
+
+static u32 lrng_jent_collectors_alloc(void)
+{
+	u32 want = min3(jent_parallel, (u32)LRNG_JENT_PARALLEL_MAX,
+			num_online_cpus()) - 1;
+
+	if (lrng_jent_collectors_backoff &&
+	    time_before(jiffies, lrng_jent_collectors_retry))
+		return lrng_jent_collectors_num;
+	lrng_jent_collectors_backoff = false;
+
+	while (lrng_jent_collectors_num < want) {
+		struct lrng_jent_collector *col =
+			&lrng_jent_collectors[lrng_jent_collectors_num];
+		struct crypto_rng *rng = crypto_alloc_rng("jitterentropy_rng",
+							  0, 0);
+
+		/*
+		 * A built-in jitterentropy_rng registers only with its
+		 * module_init (-ENOENT before). Do not try again with every
+		 * reseed, but with the first one after the back-off.
+		 */
+		if (IS_ERR(rng)) {
+			pr_warn_ratelimited("could not allocate Jitter RNG "
+					    "collector: %ld\n", PTR_ERR(rng));
+			lrng_jent_collectors_retry = jiffies + HZ;
+			lrng_jent_collectors_backoff = true;
+			break;
+		}
+		col->rng = rng;
+		INIT_WORK(&col->work, lrng_jent_collector_work);
+		lrng_jent_collectors_num++;
+	}
+
+	return lrng_jent_collectors_num;
+}
+
+/**
+ * Get Jitter RNG entropy from several collectors in parallel - the caller
+ * must be allowed to sleep and is the only caller at a time, i.e. holds
+ * lrng_pool.irq_info.reseed_in_progress or is the Jitter RNG harvest.
+ *
+ * @outbuf buffer of LRNG_JENT_PARALLEL_MAX * outbuflen bytes
+ * @outbuflen length of the output of one collector
+ * @return > 0 on success where value provides the added entropy in bits
+ *	   0 if no fast source was available
+ */
+static u32 lrng_get_jent_parallel(u8 *outbuf, unsigned int outbuflen)
+{
+	u32 i, num, ent_bits = 0;
+	int cpu, this_cpu;
+
+	if (lrng_jent_parallel_done || jent_parallel < 2 || !jitterrng ||
+	    !lrng_jent_wq)
+		return lrng_get_jent(outbuf, outbuflen);
+
+	if (lrng_pdrng.pdrng_fully_seeded) {
+		lrng_jent_collectors_free();
+		lrng_jent_parallel_done = true;
+		pr_info("Jitter RNG parallel collection completed\n");
+		return lrng_get_jent(outbuf, outbuflen);
+	}
+
+	num = lrng_jent_collectors_alloc();
+
+	this_cpu = get_cpu();
+	cpu = this_cpu;
+	for (i = 0; i < num; i++) {
+		struct lrng_jent_collector *col = &lrng_jent_collectors[i];
+
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+		if (cpu == this_cpu)
+			break;
+
+		col->outbuf = outbuf + (i + 1) * outbuflen;
+		col->outbuflen = outbuflen;
+		col->ret = -EAGAIN;
+		queue_work_on(cpu, lrng_jent_wq, &col->work);
+	}
+	put_cpu();
+	num = i;
+
+	ent_bits = lrng_get_jent(outbuf, outbuflen);
+
+	for (i = 0; i < num; i++) {
+		struct lrng_jent_collector *col = &lrng_jent_collectors[i];
+
+		flush_work(&col->work);
+		if (col->ret) {
+			pr_debug("Jitter RNG collector failed with %d\n",
+				 col->ret);
+			memzero_explicit(col->outbuf, outbuflen);
+			continue;
+		}
+		ent_bits += lrng_jent_entropy(jitterrng, outbuflen);
+	}
+
+	pr_debug("obtained %u bits of entropy from %u Jitter RNG collectors\n",
+		 ent_bits, num + 1);
+
+	return ent_bits;
+}
+
+/*
+ * Asynchronous Jitter RNG harvest
+ *
+ * The Jitter RNG is by far the slowest noise source. The primary DRNG reseed
+ * starts a harvest in the background before reading the entropy pool and the
+ * CPU noise source. The reseed waits for the harvest only if the other noise
+ * sources do not provide the DRNG security strength. Otherwise the harvest
+ * continues and its output is consumed by the next reseed.
+ *
+ * The harvest is only used once the workqueues are operational -- before,
+ * the Jitter RNG is read synchronously.
+ */
+struct lrng_jent_harvest {
+	u8 buf[LRNG_JENT_PARALLEL_MAX * LRNG_DRNG_SECURITY_STRENGTH_BYTES];
+	u32 ent_bits;
+	bool running;
+	struct work_struct work;
+	struct completion done;
+};
+
+/* Serialized by lrng_pool.irq_info.reseed_in_progress except for the work */
+static struct lrng_jent_harvest lrng_jent_harvest;
+static bool lrng_jent_harvest_avail = false;
+
+static void lrng_jent_harvest_work(struct work_struct *work)
+{
+	struct lrng_jent_harvest *h =
+		container_of(work, struct lrng_jent_harvest, work);
+
+	memset(h->buf, 0, sizeof(h->buf));
+	h->ent_bits = lrng_get_jent_parallel(h->buf,
+					     LRNG_DRNG_SECURITY_STRENGTH_BYTES);
+	complete_all(&h->done);
+}
+
+static void __init lrng_jent_harvest_init(void)
+{
+	INIT_WORK(&lrng_jent_harvest.work, lrng_jent_harvest_work);
+	init_completion(&lrng_jent_harvest.done);
+	lrng_jent_harvest_avail = true;
+
+	if (jent_parallel < 2)
+		return;
+	lrng_jent_wq = alloc_workqueue("lrng_jent",
+				       WQ_HIGHPRI | WQ_MEM_RECLAIM, 0);
+	if (!lrng_jent_wq)
+		pr_warn("could not allocate Jitter RNG collector workqueue, "
+			"parallel collection disabled\n");
+}
+
+/* Start a harvest unless one is running or its output is not consumed */
+static void lrng_jent_harvest_start(void)
+{
+	struct lrng_jent_harvest *h = &lrng_jent_harvest;
+
+	if (!lrng_jent_harvest_avail || h->running || !jitterrng)
+		return;
+
+	reinit_completion(&h->done);
+	h->running = true;
+	queue_work(lrng_wq ? lrng_wq : system_unbound_wq, &h->work);
+}
+
+/**
+ * Get Jitter RNG entropy from the harvest
+ *
+ * @outbuf buffer of LRNG_JENT_PARALLEL_MAX * LRNG_DRNG_SECURITY_STRENGTH_BYTES
+ * @wait wait for a running harvest to complete
+ * @return entropy in bits provided with outbuf, 0 if no data was available
+ */
+static u32 lrng_jent_harvest_get(u8 *outbuf, bool wait)
+{
+	struct lrng_jent_harvest *h = &lrng_jent_harvest;
+	u32 ent_bits;
+
+	if (!lrng_jent_harvest_avail)
+		return wait ? lrng_get_jent_parallel(outbuf,
+					LRNG_DRNG_SECURITY_STRENGTH_BYTES) : 0;
+
+	if (!h->running)
+		return 0;
+	if (wait)
+		wait_for_completion(&h->done);
+	else if (!completion_done(&h->done))
+		return 0;
+
+	memcpy(outbuf, h->buf, sizeof(h->buf));
+	memzero_explicit(h->buf, sizeof(h->buf));
+	ent_bits = h->ent_bits;
+	h->running = false;
+
+	return ent_bits;
+}
 #else /* CONFIG_CRYPTO_JITTERENTROPY */
-static u32 lrng_get_jent(u8 *outbuf, unsigned int outbuflen)
+#define LRNG_JENT_PARALLEL_MAX		1
+
+static inline void __init lrng_jent_harvest_init(void) { }
+static inline void lrng_jent_harvest_start(void) { }
+
+static u32 lrng_jent_harvest_get(u8 *outbuf, bool wait)
 {
 	return 0;
 }
@@ -479,6 +922,141 @@ static int __init lrng_parse_trust_cpu(char *arg)
 }
 early_param("random.trust_cpu", lrng_parse_trust_cpu);
 
+/*
+ * CPU noise source harvester
+ *
+ * RDSEED-type instructions may fail transiently when many CPUs drain the
+ * hardware entropy source at the same time. A failed word is retried
+ * LRNG_ARCH_RETRIES times with exponentially growing pauses before falling
+ * back to the RDRAND-type instruction. A block which cannot be filled only
+ * causes the current reseed to go without the CPU noise source -- the
+ * failures are counted per CPU instead of disabling the noise source.
+ */
+#define LRNG_ARCH_RETRIES	8
+#define LRNG_ARCH_WORDS		(LRNG_DRNG_SECURITY_STRENGTH_BYTES / \
+				 sizeof(unsigned long))
+
+struct lrng_arch_stat {
+	unsigned long seed;		/* Words from RDSEED */
+	unsigned long seed_retries;	/* RDSEED retries */
+	unsigned long rand;		/* Words from RDRAND fallback */
+	unsigned long failures;		/* Blocks not obtained */
+	unsigned long prefetched;	/* Blocks served from prefetch */
+};
+
+static DEFINE_PER_CPU(struct lrng_arch_stat, lrng_arch_stat);
+
+/*
+ * Optional per-CPU prefetch of one block of RDSEED output. The block is
+ * refilled by a work item on the CPU after it was consumed so that the reseed
+ * does not wait for the instruction.
+ */
+static bool arch_prefetch = false;
+module_param(arch_prefetch, bool, 0444);
+MODULE_PARM_DESC(arch_prefetch, "Keep a per-CPU block of CPU noise source "
+				"data gathered ahead of time");
+
+struct lrng_arch_prefetch {
+	unsigned long buf[LRNG_ARCH_WORDS];
+	bool filled;
+	struct work_struct refill;
+};
+
+static DEFINE_PER_CPU(struct lrng_arch_prefetch, lrng_arch_prefetch);
+
+/*
+ * Obtain one word from the CPU noise source with retry and backoff. Without
+ * a seed instruction, e.g. CPUs without RDSEED or hypervisors masking it, the
+ * retries are skipped.
+ */
+static bool lrng_arch_get_long(unsigned long *v, struct lrng_arch_stat *stat)
+{
+	u32 i, j;
+
+	for (i = 0; arch_has_random_seed() && i < LRNG_ARCH_RETRIES; i++) {
+		if (arch_get_random_seed_long(v)) {
+			stat->seed++;
+			return true;
+		}
+		stat->seed_retries++;
+		for (j = 0; j < (1U << i); j++)
+			cpu_relax();
+	}
+
+	if (arch_get_random_long(v)) {
+		stat->rand++;
+		return true;
+	}
+
+	return false;
+}
+
+/* Fill one block from the CPU noise source - preemption is disabled */
+static bool lrng_arch_get_block(unsigned long *buf)
+{
+	struct lrng_arch_stat *stat = this_cpu_ptr(&lrng_arch_stat);
+	u32 i;
+
+	for (i = 0; i < LRNG_ARCH_WORDS; i++) {
+		if (!lrng_arch_get_long(buf + i, stat)) {
+			stat->failures++;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void lrng_arch_prefetch_refill(struct work_struct *work)
+{
+	struct lrng_arch_prefetch *pf =
+		container_of(work, struct lrng_arch_prefetch, refill);
+	unsigned long buf[LRNG_ARCH_WORDS];
+	bool ok;
+
+	/* The work is bound to the CPU of the prefetch buffer */
+	preempt_disable();
+	ok = lrng_arch_get_block(buf);
+	preempt_enable();
+	if (!ok)
+		return;
+
+	local_irq_disable();
+	if (!pf->filled) {
+		memcpy(pf->buf, buf, sizeof(pf->buf));
+		pf->filled = true;
+	}
+	local_irq_enable();
+	memzero_explicit(buf, sizeof(buf));
+}
+
+/* Take the prefetched block of the local CPU and schedule its refill */
+static bool lrng_arch_prefetch_get(u8 *outbuf)
+{
+	struct lrng_arch_prefetch *pf;
+	unsigned long flags;
+	bool ret = false;
+
+	if (!arch_prefetch)
+		return false;
+
+	local_irq_save(flags);
+	pf = this_cpu_ptr(&lrng_arch_prefetch);
+	if (pf->filled) {
+		memcpy(outbuf, pf->buf, sizeof(pf->buf));
+		memzero_explicit(pf->buf, sizeof(pf->buf));
+		pf->filled = false;
+		this_cpu_inc(lrng_arch_stat.prefetched);
+		ret = true;
+	}
+	if (!pf->refill.func)
+		INIT_WORK(&pf->refill, lrng_arch_prefetch_refill);
+	queue_work_on(smp_processor_id(), system_wq, &pf->refill);
+	local_irq_restore(flags);
+
+	return ret;
+}
+
 /**
  * Get CPU noise source entropy
  *
@@ -488,8 +1066,8 @@ early_param("random.trust_cpu", lrng_parse_trust_cpu);
  */
 static inline u32 lrng_get_arch(u8 *outbuf)
 {
-	u32 i;
 	u32 ent_bits = archrandom;
+	bool ok;
 
 	/* operate on full blocks */
 	BUILD_BUG_ON(LRNG_DRNG_SECURITY_STRENGTH_BYTES % sizeof(unsigned long));
@@ -499,11 +1077,13 @@ static inline u32 lrng_get_arch(u8 *outbuf)
 	if (!ent_bits)
 		return 0;
 
-	for (i = 0; i < LRNG_DRNG_SECURITY_STRENGTH_BYTES;
-	     i += sizeof(unsigned long)) {
-		if (!arch_get_random_seed_long((unsigned long *)(outbuf + i)) &&
-		    !arch_get_random_long((unsigned long *)(outbuf + i))) {
-			archrandom = 0;
+	if (!lrng_arch_prefetch_get(outbuf)) {
+		preempt_disable();
+		ok = lrng_arch_get_block((unsigned long *)outbuf);
+		preempt_enable();
+		if (!ok) {
+			pr_debug("CPU RNG noise source temporarily "
+				 "unavailable\n");
 			return 0;
 		}
 	}
@@ -544,7 +1124,8 @@ static void lrng_pool_lfsr_u32(u32 value)
 	 * inappropriate as the data just mixed-in at these taps may be not
 	 * independent from the current data to be mixed in.
 	 */
-	u32 ptr = (u32)atomic_add_return(67, &lrng_pool.pool_ptr) &
+	u32 ptr = (u32)atomic_add_return(LRNG_POOL_PTR_STRIDE,
+					 &lrng_pool.pool_ptr) &
 							(LRNG_POOL_SIZE - 1);
 	/*
 	 * Add 7 bits of rotation to the pool. At the beginning of the
@@ -667,8 +1248,10 @@ static inline void lrng_pool_mixin(u32 irq_num)
 	if (atomic_cmpxchg(&lrng_pool.irq_info.reseed_in_progress, 0, 1))
 		return;
 
-	/* Seed the DRNG with IRQ noise. */
-	schedule_work(&lrng_pdrng.lrng_seed_work);
+	/* Seed the DRNG with IRQ noise on the node of the DRNG to be seeded. */
+	lrng_queue_work_node(lrng_sdrng_unseeded_node(),
+			     &lrng_pdrng.lrng_seed_work,
+			     &lrng_pdrng.lrng_seed_work_queued);
 }
 
 /**
@@ -749,67 +1332,343 @@ void add_device_randomness(const void *buf, unsigned int size)
 }
 EXPORT_SYMBOL(add_device_randomness);
 
-#ifdef CONFIG_BLOCK
-void rand_initialize_disk(struct gendisk *disk) { }
-void add_disk_randomness(struct gendisk *disk) { }
-EXPORT_SYMBOL(add_disk_randomness);
-#endif
+/*
+ * Time stamp batches of event noise sources other than interrupts
+ *
+ * The time stamps of the events are collected in a per-CPU batch which is
+ * mixed into the entropy pool with one LFSR pass once full. Each time stamp
+ * is subject to the stuck test with the state of the CPU. The events are far
+ * more regular than interrupt arrival times, so only one interrupt-equivalent
+ * event is credited for every oversampling number of non-stuck time stamps.
+ * The non-stuck time stamps not credited with a batch are carried over to the
+ * next batch, thus an oversampling rate larger than the batch size is honored.
+ * No entropy is credited without high-resolution time stamps.
+ */
+#define LRNG_TS_BATCH			16
+
+struct lrng_ts_batch {
+	u32 samples[LRNG_TS_BATCH];
+	u32 num;		/* Time stamps in batch */
+	u32 good;		/* Non-stuck time stamps not yet credited */
+	u32 last_time;		/* Stuck test: time of previous event */
+	u32 last_delta;		/* Stuck test: delta of previous event */
+	u32 last_delta2;	/* Stuck test: 2. time derivation */
+};
+
+struct lrng_ts_stat {
+	atomic64_t samples;	/* Time stamps mixed into the pool */
+	atomic64_t events;	/* Interrupt-equivalent events credited */
+};
 
-/* Hash the entire entropy pool - lrng_pdrng.lock must be held */
-static inline u32 lrng_hash_pool(u8 *outbuf, u32 avail_entropy_bits)
+/* Stuck test as for interrupts, see lrng_irq_stuck - IRQs are disabled */
+static inline bool lrng_ts_stuck(struct lrng_ts_batch *batch, u32 now_time)
 {
-	const struct lrng_crypto_cb *crypto_cb = lrng_pdrng.crypto_cb;
-	u32 digestsize = crypto_cb->lrng_hash_digestsize(lrng_pool.lrng_hash);
-	u32 avail_entropy_bytes = avail_entropy_bits >> 3;
-	u32 i, generated_bytes = 0;
-	u8 digest[64] __aligned(LRNG_KCAPI_ALIGN);
+	u32 delta = now_time - batch->last_time;
+	int delta2 = delta - batch->last_delta;
+	int delta3 = delta2 - batch->last_delta2;
 
-	BUG_ON(digestsize > sizeof(digest));
+	batch->last_time = now_time;
+	batch->last_delta = delta;
+	batch->last_delta2 = delta2;
 
-	if (avail_entropy_bytes > LRNG_DRNG_SECURITY_STRENGTH_BYTES) {
-		pr_err("Available entropy (%u) larger than expected (%u)\n",
-		       avail_entropy_bytes, LRNG_DRNG_SECURITY_STRENGTH_BYTES);
-		avail_entropy_bytes = LRNG_DRNG_SECURITY_STRENGTH_BYTES;
-	}
+	return (!delta || !delta2 || !delta3);
+}
 
-	for (i = 0;
-	     i < LRNG_DRNG_SECURITY_STRENGTH_BYTES && avail_entropy_bytes > 0;
-	     i += digestsize) {
-		u32 tocopy = min3(avail_entropy_bytes, digestsize,
-				  (LRNG_DRNG_SECURITY_STRENGTH_BYTES - i));
+/*
+ * Add a time stamp to the batch of the local CPU - IRQs must be disabled.
+ * A time stamp added without credit is only mixed into the pool.
+ * Returns the number of events to be credited by the caller.
+ */
+static inline u32 lrng_ts_batch_add(struct lrng_ts_batch *batch,
+				    struct lrng_ts_stat *stat, u32 now_time,
+				    u32 oversampling, bool credit)
+{
+	u32 events;
 
-		if (crypto_cb->lrng_hash_buffer(lrng_pool.lrng_hash,
-						(u8 *)lrng_pool.pool,
-						LRNG_POOL_SIZE_BYTES, digest))
-			goto out;
+	oversampling = max_t(u32, oversampling, 1);
+	batch->samples[batch->num++] = now_time;
+	if (!lrng_ts_stuck(batch, now_time) && credit)
+		batch->good++;
+	if (batch->num < LRNG_TS_BATCH)
+		return 0;
 
-		/* Mix read data back into pool for backtracking resistance */
-		lrng_pool_lfsr(digest, digestsize);
-		/* Copy the data out to the caller */
-		memcpy(outbuf + i, digest, tocopy);
-		avail_entropy_bytes -= tocopy;
-		generated_bytes += tocopy;
-	}
+	lrng_pool_lfsr((u8 *)batch->samples, sizeof(batch->samples));
+	events = batch->good / oversampling;
+	batch->num = 0;
+	batch->good -= events * oversampling;
 
-out:
-	memzero_explicit(digest, digestsize);
-	return (generated_bytes<<3);
+	atomic64_add(LRNG_TS_BATCH, &stat->samples);
+	if (!events || !lrng_pool.irq_info.irq_highres_timer)
+		return 0;
+
+	atomic64_add(events, &stat->events);
+	return events;
 }
 
-int __init rand_initialize(void)
-{
-	ktime_t now_time = ktime_get_real();
-	unsigned int i, rand;
+#ifdef CONFIG_BLOCK
+/*
+ * Block device completion timing noise source
+ *
+ * blk-mq reports every request completion of a queue flagged with
+ * QUEUE_FLAG_ADD_RANDOM with add_disk_randomness (see the kernel patch
+ * "block: report blk-mq request completions to the LRNG"). Completions
+ * handled in interrupt context, i.e. in the hard or soft interrupt of the
+ * device, are already credited as interrupt: their time stamps are mixed
+ * into the pool without credit. Only completions reaped in process context
+ * are credited, e.g. polled NVMe or io_uring IOPOLL requests or null_blk
+ * without interrupt emulation. The time stamps are batched per CPU: a
+ * hardware queue completes on the CPUs mapped to it, so there is no shared
+ * cache line between hardware queues.
+ */
+#define LRNG_DISK_OVERSAMPLING		8
 
-	lrng_pool_lfsr_u32(now_time);
-	for (i = 0; i < LRNG_POOL_SIZE; i++) {
-		if (!arch_get_random_seed_int(&rand) &&
-		    !arch_get_random_int(&rand))
-			rand = random_get_entropy();
+static u32 disk_oversampling = LRNG_DISK_OVERSAMPLING;
+module_param(disk_oversampling, uint, 0444);
+MODULE_PARM_DESC(disk_oversampling, "Number of block device completion time "
+				    "stamps credited as one interrupt");
+
+static DEFINE_PER_CPU(struct lrng_ts_batch, lrng_disk_batch);
+static struct lrng_ts_stat lrng_disk_stat;
+
+void rand_initialize_disk(struct gendisk *disk) { }
+
+void add_disk_randomness(struct gendisk *disk)
+{
+	u32 now_time = random_get_entropy();
+	unsigned long flags;
+	u32 events;
+
+	if (!disk)
+		return;
+
+	local_irq_save(flags);
+	events = lrng_ts_batch_add(this_cpu_ptr(&lrng_disk_batch),
+				   &lrng_disk_stat, now_time,
+				   disk_oversampling, !in_interrupt());
+	local_irq_restore(flags);
+
+	if (events)
+		lrng_pool_mixin(atomic_add_return(events,
+					&lrng_pool.irq_info.num_events));
+}
+EXPORT_SYMBOL(add_disk_randomness);
+#endif
+
+#ifdef CONFIG_TRACEPOINTS
+/*
+ * Context switch timing noise source
+ *
+ * Optional source for guests receiving few interrupts, e.g. with polling
+ * virtio drivers and NO_HZ_FULL. The time stamp of every context switch is
+ * added to the batch of the CPU. The probe executes with the runqueue lock
+ * held and thus must not wake up anybody: the reseed check of
+ * lrng_pool_mixin is deferred to an irq_work.
+ */
+#define LRNG_SCHED_OVERSAMPLING		32
+
+static bool sched_noise = false;
+module_param(sched_noise, bool, 0444);
+MODULE_PARM_DESC(sched_noise, "Use context switch timing as noise source");
+
+static u32 sched_oversampling = LRNG_SCHED_OVERSAMPLING;
+module_param(sched_oversampling, uint, 0444);
+MODULE_PARM_DESC(sched_oversampling, "Number of context switch time stamps "
+				     "credited as one interrupt");
+
+static DEFINE_PER_CPU(struct lrng_ts_batch, lrng_sched_batch);
+static struct lrng_ts_stat lrng_sched_stat;
+static struct irq_work lrng_sched_irq_work;
+
+static void lrng_sched_irq_work_func(struct irq_work *work)
+{
+	lrng_pool_mixin(atomic_read_u32(&lrng_pool.irq_info.num_events));
+}
+
+static void lrng_sched_switch(void *data, bool preempt,
+			      struct task_struct *prev,
+			      struct task_struct *next)
+{
+	u32 events = lrng_ts_batch_add(this_cpu_ptr(&lrng_sched_batch),
+				       &lrng_sched_stat, random_get_entropy(),
+				       sched_oversampling, true);
+
+	if (!events)
+		return;
+
+	atomic_add(events, &lrng_pool.irq_info.num_events);
+	irq_work_queue(&lrng_sched_irq_work);
+}
+
+static void __init lrng_sched_noise_init(void)
+{
+	int ret;
+
+	if (!sched_noise)
+		return;
+
+	init_irq_work(&lrng_sched_irq_work, lrng_sched_irq_work_func);
+	ret = register_trace_sched_switch(lrng_sched_switch, NULL);
+	if (ret)
+		pr_warn("context switch noise source unavailable (%d)\n", ret);
+	else
+		pr_info("context switch noise source enabled\n");
+}
+#else /* CONFIG_TRACEPOINTS */
+static inline void __init lrng_sched_noise_init(void) { }
+#endif /* CONFIG_TRACEPOINTS */
+
+/*
+ * Partial pool read: the words written since the last read are found by
+ * walking back from the LFSR write pointer. They are read in multiples of one
+ * hash input block (SHA-1 and BLAKE2s: 64 bytes) which also is the minimum
+ * number of words the SHA-1 conditioning of the ChaCha20 backend can process.
+ */
+#define LRNG_POOL_READ_BLOCK_WORDS	16
+
+/* Copy of the pool words for a partial read -- lrng_pdrng.lock protects it */
+static u32 lrng_pool_read_buf[LRNG_POOL_SIZE] __aligned(LRNG_KCAPI_ALIGN);
+
+/* Number of pool words written since the last read - lrng_pdrng.lock held */
+static inline u32 lrng_pool_dirty_words(u32 ptr)
+{
+	u32 written = ptr - lrng_pool.read_ptr;
+
+	return min_t(u32, written / LRNG_POOL_PTR_STRIDE, LRNG_POOL_SIZE);
+}
+
+/*
+ * Number of pool words to hash for a partial read covering the IRQs not seen
+ * by the last pool read, or 0 if the entire pool must be hashed.
+ *
+ * The partial read is only used if the requested entropy fits into one
+ * digest and is covered by the interrupts received since the last read
+ * alone. Interrupts left unused by the last read are only credited with
+ * a full pool read as their words may be outside the dirty region. Every
+ * interrupt writes at least one pool word, so more new interrupts than
+ * dirty words indicate entropy credited without pool data which is only
+ * trusted with a full pool read as well.
+ */
+static inline u32 lrng_pool_read_words(u32 ptr, u32 avail_entropy_bits,
+				       u32 digestsize, u32 irq_num_events)
+{
+	u32 dirty = lrng_pool_dirty_words(ptr);
+	u32 words = round_up(max_t(u32, dirty, 1), LRNG_POOL_READ_BLOCK_WORDS);
+	u32 new_events = irq_num_events -
+			 min_t(u32, irq_num_events, lrng_pool.read_events_back);
+
+	if ((avail_entropy_bits >> 3) > digestsize ||
+	    words >= LRNG_POOL_SIZE ||
+	    new_events > dirty ||
+	    lrng_data_to_entropy(new_events) < avail_entropy_bits)
+		return 0;
+
+	return words;
+}
+
+/* Copy the given number of pool words written up to ptr */
+static inline void lrng_pool_read_dirty(u32 ptr, u32 words)
+{
+	u32 i;
+
+	for (i = 0; i < words; i++, ptr -= LRNG_POOL_PTR_STRIDE)
+		lrng_pool_read_buf[i] = atomic_read_u32(
+				&lrng_pool.pool[ptr & (LRNG_POOL_SIZE - 1)]);
+}
+
+/*
+ * Hash the entropy pool - lrng_pdrng.lock must be held
+ *
+ * Either the entire pool is hashed or only the region written since the last
+ * read, see lrng_pool_read_words.
+ */
+static inline u32 lrng_hash_pool(u8 *outbuf, u32 avail_entropy_bits,
+				 u32 irq_num_events)
+{
+	const struct lrng_crypto_cb *crypto_cb = lrng_pdrng.crypto_cb;
+	u32 digestsize = crypto_cb->lrng_hash_digestsize(lrng_pool.lrng_hash);
+	u32 avail_entropy_bytes = avail_entropy_bits >> 3;
+	u32 ptr = atomic_read_u32(&lrng_pool.pool_ptr);
+	u32 i, words, generated_bytes = 0;
+	u8 digest[64] __aligned(LRNG_KCAPI_ALIGN);
+
+	BUG_ON(digestsize > sizeof(digest));
+
+	if (avail_entropy_bytes > LRNG_DRNG_SECURITY_STRENGTH_BYTES) {
+		pr_err("Available entropy (%u) larger than expected (%u)\n",
+		       avail_entropy_bytes, LRNG_DRNG_SECURITY_STRENGTH_BYTES);
+		avail_entropy_bytes = LRNG_DRNG_SECURITY_STRENGTH_BYTES;
+	}
+
+	words = lrng_pool_read_words(ptr, avail_entropy_bits, digestsize,
+				     irq_num_events);
+	if (words)
+		lrng_pool_read_dirty(ptr, words);
+
+	for (i = 0;
+	     i < LRNG_DRNG_SECURITY_STRENGTH_BYTES && avail_entropy_bytes > 0;
+	     i += digestsize) {
+		u32 tocopy = min3(avail_entropy_bytes, digestsize,
+				  (LRNG_DRNG_SECURITY_STRENGTH_BYTES - i));
+		int ret;
+
+		if (words)
+			ret = crypto_cb->lrng_hash_buffer(lrng_pool.lrng_hash,
+						(u8 *)lrng_pool_read_buf,
+						words * LRNG_POOL_WORD_BYTES,
+						digest);
+		else
+			ret = crypto_cb->lrng_hash_buffer(lrng_pool.lrng_hash,
+						(u8 *)lrng_pool.pool,
+						LRNG_POOL_SIZE_BYTES, digest);
+		if (ret)
+			goto out;
+
+		/* Mix read data back into pool for backtracking resistance */
+		lrng_pool_lfsr(digest, digestsize);
+		/* Copy the data out to the caller */
+		memcpy(outbuf + i, digest, tocopy);
+		avail_entropy_bytes -= tocopy;
+		generated_bytes += tocopy;
+	}
+
+out:
+	memzero_explicit(digest, digestsize);
+	if (words)
+		memzero_explicit(lrng_pool_read_buf,
+				 words * LRNG_POOL_WORD_BYTES);
+
+	/*
+	 * Words written while the pool was read, including the digest mixed
+	 * back, are part of the next dirty region.
+	 */
+	lrng_pool.read_ptr = ptr;
+	lrng_pool.read_events_back = irq_num_events -
+		min_t(u32, irq_num_events,
+		      lrng_entropy_to_data(generated_bytes << 3));
+
+	return (generated_bytes<<3);
+}
+
+int __init rand_initialize(void)
+{
+	ktime_t now_time = ktime_get_real();
+	unsigned int i, rand;
+
+	lrng_pool_lfsr_u32(now_time);
+	for (i = 0; i < LRNG_POOL_SIZE; i++) {
+		if (!arch_get_random_seed_int(&rand) &&
+		    !arch_get_random_int(&rand))
+			rand = random_get_entropy();
 		lrng_pool_lfsr_u32(rand);
 	}
 	lrng_pool_lfsr_nonaligned((u8 *)utsname(), sizeof(*(utsname())));
 
+	lrng_wq = alloc_workqueue("lrng",
+				  WQ_UNBOUND | WQ_HIGHPRI | WQ_MEM_RECLAIM, 0);
+	if (!lrng_wq)
+		pr_warn("could not allocate LRNG workqueue, using system "
+			"workqueue\n");
+
 	return 0;
 }
 
@@ -874,7 +1733,8 @@ static u32 lrng_get_pool(u8 *outbuf, u32 requested_entropy_bits, bool drain)
 	avail_entropy_bits = round_down(avail_entropy_bits, 8);
 
 	mutex_lock(&lrng_pdrng.lock);
-	avail_entropy_bits = lrng_hash_pool(outbuf, avail_entropy_bits);
+	avail_entropy_bits = lrng_hash_pool(outbuf, avail_entropy_bits,
+					    irq_num_events);
 	mutex_unlock(&lrng_pdrng.lock);
 
 out:
@@ -1063,7 +1923,7 @@ static int lrng_pdrng_seed_locked(u8 *outbuf, u32 outbuflen, bool fullentropy,
 	struct {
 		u8 a[LRNG_DRNG_SECURITY_STRENGTH_BYTES];
 		u8 b[LRNG_DRNG_SECURITY_STRENGTH_BYTES];
-		u8 c[LRNG_DRNG_SECURITY_STRENGTH_BYTES];
+		u8 c[LRNG_JENT_PARALLEL_MAX * LRNG_DRNG_SECURITY_STRENGTH_BYTES];
 		u32 now;
 	} entropy_buf __aligned(LRNG_KCAPI_ALIGN);
 	int ret, retrieved = 0;
@@ -1084,6 +1944,9 @@ static int lrng_pdrng_seed_locked(u8 *outbuf, u32 outbuflen, bool fullentropy,
 		/* Disregard error code as another generate request is below. */
 	}
 
+	/* Let the Jitter RNG work while the other noise sources are read */
+	lrng_jent_harvest_start();
+
 	/*
 	 * drain the pool completely during init and when /dev/random calls.
 	 *
@@ -1101,8 +1964,14 @@ static int lrng_pdrng_seed_locked(u8 *outbuf, u32 outbuflen, bool fullentropy,
 	 * than the DRNG strength to be able to feed /dev/random.
 	 */
 	total_entropy_bits += lrng_get_arch(entropy_buf.b);
-	total_entropy_bits += lrng_get_jent(entropy_buf.c,
-					    LRNG_DRNG_SECURITY_STRENGTH_BYTES);
+	/*
+	 * Not all parallel Jitter RNG collector slots may be filled. Wait for
+	 * the Jitter RNG only if the DRNG security strength is not reached
+	 * otherwise, else take its output if it is already available.
+	 */
+	memset(entropy_buf.c, 0, sizeof(entropy_buf.c));
+	total_entropy_bits += lrng_jent_harvest_get(entropy_buf.c,
+			total_entropy_bits < LRNG_DRNG_SECURITY_STRENGTH_BITS);
 
 	pr_debug("reseed primary DRNG from internal noise sources with %u bits "
 		 "of entropy\n", total_entropy_bits);
@@ -1184,6 +2053,47 @@ static int lrng_pdrng_get(u8 *outbuf, u32 outbuflen)
 
 /************************ secondary DRNG processing **************************/
 
+static const struct lrng_drng_caps lrng_drng_caps_default = {
+	.version	= LRNG_DRNG_CAPS_VERSION,
+	.flags		= LRNG_DRNG_CAP_PARALLEL,
+};
+
+/* Capability hints of the backend */
+static inline const struct lrng_drng_caps *
+lrng_drng_caps(const struct lrng_crypto_cb *cb)
+{
+	const struct lrng_drng_caps *caps = cb->lrng_drng_caps;
+
+	return (caps && caps->version) ? caps : &lrng_drng_caps_default;
+}
+
+/* Maximum request size for one generate operation of the backend */
+static inline u32 lrng_drng_max_reqsize(const struct lrng_crypto_cb *cb)
+{
+	const struct lrng_drng_caps *caps = lrng_drng_caps(cb);
+
+	if (!caps->max_reqsize)
+		return LRNG_DRNG_MAX_REQSIZE;
+
+	return clamp_t(u32, caps->max_reqsize, LRNG_DRNG_MAX_REQSIZE,
+		       LRNG_DRNG_MAX_REQSIZE_BULK);
+}
+
+/*
+ * Size of the next generate operation for a request of len bytes: at most the
+ * maximum request size, split at a multiple of the preferred granularity.
+ */
+static inline u32 lrng_drng_chunk(const struct lrng_crypto_cb *cb, u32 len)
+{
+	const struct lrng_drng_caps *caps = lrng_drng_caps(cb);
+	u32 todo = min_t(u32, len, lrng_drng_max_reqsize(cb));
+
+	if (caps->chunk_size && todo < len && todo >= caps->chunk_size)
+		todo = rounddown(todo, caps->chunk_size);
+
+	return todo;
+}
+
 static __always_inline bool lrng_sdrng_is_atomic(struct lrng_sdrng *sdrng)
 {
 	/*
@@ -1193,6 +2103,31 @@ static __always_inline bool lrng_sdrng_is_atomic(struct lrng_sdrng *sdrng)
 	return (sdrng->sdrng == lrng_sdrng_atomic.sdrng);
 }
 
+static inline enum lrng_sdrng_tier lrng_sdrng_tier(struct lrng_sdrng *sdrng)
+{
+	if (sdrng == &lrng_sdrng_atomic)
+		return LRNG_SDRNG_TIER_ATOMIC;
+	if (sdrng == &lrng_sdrng_init && !READ_ONCE(lrng_sdrng))
+		return LRNG_SDRNG_TIER_INIT;
+	return LRNG_SDRNG_TIER_NODE;
+}
+
+/*
+ * Is the secondary DRNG due for a reseed? The byte counter is only updated
+ * under the lock of the DRNG. It is read without the lock as a stale value
+ * merely shifts the reseed by one request.
+ */
+static inline bool lrng_sdrng_reseed_due(struct lrng_sdrng *sdrng)
+{
+	enum lrng_sdrng_tier tier = lrng_sdrng_tier(sdrng);
+
+	return (READ_ONCE(sdrng->bytes) >=
+		READ_ONCE(lrng_sdrng_reseed_bytes[tier]) ||
+		sdrng->force_reseed ||
+		time_after(jiffies, sdrng->last_seeded +
+			   READ_ONCE(lrng_sdrng_reseed_secs[tier]) * HZ));
+}
+
 /* Lock the secondary DRNG */
 static __always_inline void lrng_sdrng_lock(struct lrng_sdrng *sdrng,
 					    unsigned long *flags)
@@ -1214,6 +2149,89 @@ static __always_inline void lrng_sdrng_unlock(struct lrng_sdrng *sdrng,
 		mutex_unlock(&sdrng->lock);
 }
 
+/*
+ * Maximum number of secondary DRNG reseeds executed concurrently by the
+ * reseed scheduler. Further due reseeds are deferred.
+ */
+static u32 reseed_max_concurrent = 1;
+
+/* Zero concurrent reseeds would defer every reseed forever */
+static int lrng_reseed_max_concurrent_set(const char *val,
+					  const struct kernel_param *kp)
+{
+	u32 num;
+	int ret = kstrtouint(val, 0, &num);
+
+	if (ret)
+		return ret;
+	if (!num)
+		return -EINVAL;
+
+	*(u32 *)kp->arg = num;
+	return 0;
+}
+
+static const struct kernel_param_ops lrng_reseed_max_concurrent_ops = {
+	.set	= lrng_reseed_max_concurrent_set,
+	.get	= param_get_uint,
+};
+module_param_cb(reseed_max_concurrent, &lrng_reseed_max_concurrent_ops,
+		&reseed_max_concurrent, 0644);
+MODULE_PARM_DESC(reseed_max_concurrent, "Maximum number of concurrently "
+					"executed secondary DRNG reseeds");
+
+static atomic_t lrng_sdrng_reseeds_active = ATOMIC_INIT(0);
+
+/**
+ * Arm the reseed timer of a secondary DRNG that was just seeded.
+ *
+ * The reseed deadlines of the NUMA node DRNGs are phase-shifted evenly across
+ * the reseed interval based on the node number. The deadline is the first
+ * point in time after now that is aligned with the phase of the node. Thus,
+ * the reseeds of the different nodes never coincide regardless of when they
+ * were seeded, and a DRNG is reseeded at the latest one interval after its
+ * last seeding.
+ *
+ * A reseed interval of zero implies a reseed with every request which is
+ * handled by lrng_sdrng_get.
+ */
+static void lrng_sdrng_reseed_arm(struct lrng_sdrng *sdrng)
+{
+	u64 interval = (u64)READ_ONCE(
+			lrng_sdrng_reseed_secs[lrng_sdrng_tier(sdrng)]) * HZ;
+	u64 now = get_jiffies_64();
+	u64 phase, next;
+
+	if (!interval || READ_ONCE(sdrng->retired))
+		return;
+
+	phase = div_u64(interval * max(sdrng->node, 0), nr_node_ids);
+	if (now < phase)
+		next = phase;
+	else
+		next = phase + (div64_u64(now - phase, interval) + 1) *
+			       interval;
+
+	mod_timer(&sdrng->reseed_timer, jiffies + (unsigned long)(next - now));
+}
+
+/* Trigger the reseed of a secondary DRNG on a worker of its NUMA node */
+static inline void lrng_sdrng_reseed_schedule(struct lrng_sdrng *sdrng)
+{
+	lrng_queue_work_node(sdrng->node, &sdrng->reseed_work,
+			     &sdrng->reseed_work_queued);
+}
+
+/* Reseed deadline of a secondary DRNG has passed */
+static void lrng_sdrng_reseed_timer(struct timer_list *t)
+{
+	struct lrng_sdrng *sdrng = from_timer(sdrng, t, reseed_timer);
+
+	if (!READ_ONCE(sdrng->retired))
+		lrng_sdrng_reseed_schedule(sdrng);
+}
+
+static void lrng_prefetch_invalidate(void);
 /**
  * Inject a data buffer into the secondary DRNG
  *
@@ -1232,24 +2250,27 @@ static void lrng_sdrng_inject(struct lrng_sdrng *sdrng,
 				"atomic" : "secondary";
 	unsigned long flags = 0;
 
-	BUILD_BUG_ON(LRNG_DRNG_RESEED_THRESH > INT_MAX);
 	pr_debug("seeding %s DRNG with %u bytes\n", drng_type, inbuflen);
 	lrng_sdrng_lock(sdrng, &flags);
 	if (sdrng->crypto_cb->lrng_drng_seed_helper(sdrng->sdrng,
 						    inbuf, inbuflen) < 0) {
 		pr_warn("seeding of %s DRNG failed\n", drng_type);
-		atomic_set(&sdrng->requests, 1);
+		sdrng->force_reseed = true;
 	} else if (internal) {
 		pr_debug("%s DRNG stats since last seeding: %lu secs; "
-			 "generate calls: %d\n", drng_type,
+			 "generated bytes: %lu\n", drng_type,
 			 (time_after(jiffies, sdrng->last_seeded) ?
 			  (jiffies - sdrng->last_seeded) : 0) / HZ,
-			 (LRNG_DRNG_RESEED_THRESH -
-			  atomic_read(&sdrng->requests)));
+			 sdrng->bytes);
 		sdrng->last_seeded = jiffies;
-		atomic_set(&sdrng->requests, LRNG_DRNG_RESEED_THRESH);
+		sdrng->bytes = 0;
+		if (sdrng != &lrng_sdrng_atomic && !sdrng->group_drng)
+			lrng_sdrng_reseed_arm(sdrng);
 	}
 	lrng_sdrng_unlock(sdrng, &flags);
+
+	if (sdrng != &lrng_sdrng_atomic && !sdrng->group_drng)
+		lrng_prefetch_invalidate();
 }
 
 static int lrng_sdrng_get(u8 *outbuf, u32 outbuflen);
@@ -1276,49 +2297,162 @@ static void lrng_sdrng_seed(struct lrng_sdrng *sdrng,
 	if (ret < 0) {
 		/*
 		 * Try to reseed at next round - note if EINPROGRESS is returned
-		 * the request counter may fall below zero in case of parallel
-		 * operations. We accept such "underflow" temporarily as the
-		 * counter will be set back to a positive number in the course
-		 * of the reseed. For these few generate operations under
-		 * heavy parallel strain of /dev/urandom we therefore exceed
-		 * the LRNG_DRNG_RESEED_THRESH threshold.
+		 * a parallel reseed is in progress. Generate operations under
+		 * heavy parallel strain of /dev/urandom may therefore exceed
+		 * the reseed budget until that reseed completes.
 		 */
 		if (ret != -EINPROGRESS)
-			atomic_set(&sdrng->requests, 1);
+			sdrng->force_reseed = true;
 		return;
 	}
 
 	lrng_sdrng_inject(sdrng, seedbuf, ret, true);
+	memzero_explicit(seedbuf, sizeof(seedbuf));
+	atomic64_inc(&lrng_seed_level_seeds[sdrng->group_drng ?
+					    LRNG_SEED_LEVEL_NODE :
+					    LRNG_SEED_LEVEL_PRIMARY]);
 
 	sdrng->force_reseed = false;
 
 	if (ret >= LRNG_DRNG_SECURITY_STRENGTH_BYTES)
 		sdrng->fully_seeded = true;
+}
 
-	/*
-	 * Reseed atomic DRNG from current secondary DRNG,
-	 *
-	 * We can obtain random numbers from secondary DRNG as the lock type
-	 * chosen by lrng_sdrng_get is usable with the current caller.
-	 */
-	if ((sdrng->sdrng != lrng_sdrng_atomic.sdrng) &&
-	    (lrng_sdrng_atomic.force_reseed ||
-	     atomic_read(&lrng_sdrng_atomic.requests) <= 0 ||
-	     time_after(jiffies, lrng_sdrng_atomic.last_seeded +
-		        lrng_sdrng_reseed_max_time * HZ))) {
-		ret = lrng_sdrng_get(seedbuf, sizeof(seedbuf));
+/**
+ * Reseed a secondary DRNG when its reseed deadline passed or when the read
+ * path found it due for a reseed. At most reseed_max_concurrent reseeds are
+ * executed at the same time, only one if seeding the backend is expensive.
+ * A reseed that is deferred or that could not
+ * obtain data from the primary DRNG is retried shortly.
+ */
+static void lrng_sdrng_reseed_work(struct work_struct *work)
+{
+	struct lrng_sdrng *sdrng =
+			container_of(work, struct lrng_sdrng, reseed_work);
+	unsigned long last_seeded = sdrng->last_seeded;
+	u32 max_concurrent = reseed_max_concurrent;
 
-		if (ret < 0) {
-			pr_warn("Error generating random numbers for atomic DRNG: %d\n",
-				ret);
-		} else {
-			lrng_sdrng_inject(&lrng_sdrng_atomic, seedbuf, ret,
-					  true);
-			lrng_sdrng_atomic.force_reseed = false;
+	lrng_seed_latency(sdrng->reseed_work_queued);
+
+	if (READ_ONCE(sdrng->retired))
+		return;
+
+	if (lrng_drng_caps(READ_ONCE(sdrng->crypto_cb))->flags &
+	    LRNG_DRNG_CAP_SEED_EXPENSIVE)
+		max_concurrent = 1;
+
+	if (atomic_inc_return(&lrng_sdrng_reseeds_active) > max_concurrent) {
+		atomic_dec(&lrng_sdrng_reseeds_active);
+		goto retry;
+	}
+
+	lrng_sdrng_seed(sdrng, lrng_pdrng_seed);
+	atomic_dec(&lrng_sdrng_reseeds_active);
+
+	/* Successful seeding armed the timer for the next deadline */
+	if (sdrng->last_seeded != last_seeded)
+		return;
+
+retry:
+	mod_timer(&sdrng->reseed_timer, jiffies + HZ);
+}
+
+struct lrng_sdrng_seed_req {
+	struct work_struct work;
+	struct lrng_sdrng *sdrng;
+	u32 node;
+	u8 seed[LRNG_DRNG_SECURITY_STRENGTH_BYTES] __aligned(LRNG_KCAPI_ALIGN);
+};
+
+/* Seed one secondary DRNG on a worker of its NUMA node */
+static void lrng_sdrng_seed_node_work(struct work_struct *work)
+{
+	struct lrng_sdrng_seed_req *req =
+			container_of(work, struct lrng_sdrng_seed_req, work);
+	struct lrng_sdrng *sdrng = req->sdrng;
+
+	lrng_sdrng_inject(sdrng, req->seed, sizeof(req->seed), true);
+	memzero_explicit(req->seed, sizeof(req->seed));
+	atomic64_inc(&lrng_seed_level_seeds[LRNG_SEED_LEVEL_PRIMARY]);
+
+	sdrng->force_reseed = false;
+	sdrng->fully_seeded = true;
+	pr_debug("secondary DRNG on NUMA node %u fully seeded\n", req->node);
+}
+
+/**
+ * Seed all secondary DRNGs that are not yet fully seeded in one batch once
+ * the primary DRNG is fully seeded. Instead of waiting for the interrupt
+ * noise source to trigger one reseed per NUMA node, independent seeds are
+ * generated from the primary DRNG in one go, similarly to the atomic DRNG
+ * which is seeded from the output of a fully seeded secondary DRNG. The seeds
+ * are then injected concurrently by workers local to each node.
+ *
+ * lrng_pool.irq_info.reseed_in_progress must be held by caller.
+ */
+static void lrng_sdrngs_seed_batch(void)
+{
+	const struct lrng_crypto_cb *crypto_cb;
+	struct lrng_sdrng_seed_req *reqs;
+	u32 node, seeded = 0;
+
+	reqs = kcalloc(nr_node_ids, sizeof(*reqs), GFP_KERNEL);
+	if (!reqs)
+		return;
+
+	mutex_lock(&lrng_pdrng.lock);
+	if (!lrng_pdrng.pdrng_fully_seeded) {
+		mutex_unlock(&lrng_pdrng.lock);
+		goto out;
+	}
+
+	crypto_cb = lrng_pdrng.crypto_cb;
+	for_each_node_mask(node, lrng_sdrng_nodes) {
+		struct lrng_sdrng *sdrng = lrng_sdrng[node];
+		struct lrng_sdrng_seed_req *req = &reqs[node];
+		int ret;
+
+		if (!sdrng || sdrng->fully_seeded)
+			continue;
+
+		ret = crypto_cb->lrng_drng_generate_helper(lrng_pdrng.pdrng,
+							   req->seed,
+							   sizeof(req->seed));
+		if (ret != sizeof(req->seed)) {
+			pr_warn("getting seed for secondary DRNG on NUMA node "
+				"%u failed (%d)\n", node, ret);
+			continue;
 		}
+
+		req->sdrng = sdrng;
+		req->node = node;
 	}
+	mutex_unlock(&lrng_pdrng.lock);
 
-	memzero_explicit(seedbuf, sizeof(seedbuf));
+	for_each_node(node) {
+		struct lrng_sdrng_seed_req *req = &reqs[node];
+
+		if (!req->sdrng)
+			continue;
+
+		INIT_WORK(&req->work, lrng_sdrng_seed_node_work);
+		queue_work_node(node, lrng_wq ? lrng_wq : system_unbound_wq,
+				&req->work);
+	}
+
+	for_each_node(node) {
+		if (!reqs[node].sdrng)
+			continue;
+
+		flush_work(&reqs[node].work);
+		seeded++;
+	}
+
+	if (seeded)
+		pr_info("%u secondary DRNGs seeded in parallel\n", seeded);
+
+out:
+	kzfree(reqs);
 }
 
 static inline void _lrng_sdrng_seed_work(struct lrng_sdrng *sdrng, u32 node)
@@ -1326,27 +2460,29 @@ static inline void _lrng_sdrng_seed_work(struct lrng_sdrng *sdrng, u32 node)
 	pr_debug("reseed triggered by interrupt noise source "
 		 "for secondary DRNG on NUMA node %d\n", node);
 	lrng_sdrng_seed(sdrng, lrng_pdrng_seed_locked);
-	if (sdrng->fully_seeded) {
-		/* Prevent reseed storm */
-		sdrng->last_seeded += node * 100 * HZ;
-		/* Prevent draining of pool on idle systems */
-		lrng_sdrng_reseed_max_time += 100;
-	}
 }
 
 /**
- * DRNG reseed trigger: Kernel thread handler triggered by the schedule_work()
+ * DRNG reseed trigger: Kernel thread handler triggered by lrng_pool_mixin
  */
 static void lrng_sdrng_seed_work(struct work_struct *dummy)
 {
 	u32 node;
 
+	lrng_seed_latency(lrng_pdrng.lrng_seed_work_queued);
+
 	if (lrng_sdrng) {
-		for_each_online_node(node) {
+		for_each_node_mask(node, lrng_sdrng_nodes) {
 			struct lrng_sdrng *sdrng = lrng_sdrng[node];
 
 			if (sdrng && !sdrng->fully_seeded) {
 				_lrng_sdrng_seed_work(sdrng, node);
+				/*
+				 * The primary DRNG is now fully seeded, seed
+				 * all remaining nodes in one go.
+				 */
+				if (sdrng->fully_seeded)
+					lrng_sdrngs_seed_batch();
 				goto out;
 			}
 		}
@@ -1361,55 +2497,409 @@ out:
 	atomic_set(&lrng_pool.irq_info.reseed_in_progress, 0);
 }
 
+static void lrng_drngs_numa_alloc(void);
 /**
- * Get random data out of the secondary DRNG which is reseeded frequently. In
- * the worst case, the DRNG may generate random numbers without being reseeded
- * for LRNG_DRNG_RESEED_THRESH requests times LRNG_DRNG_MAX_REQSIZE bytes.
- *
- * If the DRNG is not yet initialized, use the initial RNG output.
- *
- * @outbuf: buffer for storing random data
- * @outbuflen: length of outbuf
- * @return: < 0 in error case (DRNG generation or update failed)
- *	    >=0 returning the returned number of bytes
+ * Select the secondary DRNG of the given NUMA node. If the node has no DRNG
+ * yet, e.g. because it came online after the boot-time allocation, its
+ * allocation is triggered and the initial secondary DRNG serves the request
+ * in the meantime.
  */
-static int lrng_sdrng_get(u8 *outbuf, u32 outbuflen)
+static inline struct lrng_sdrng *lrng_sdrng_node(int node)
 {
+	struct lrng_sdrng **sdrngs = READ_ONCE(lrng_sdrng);
 	struct lrng_sdrng *sdrng;
+
+	if (!sdrngs)
+		return &lrng_sdrng_init;
+
+	sdrng = READ_ONCE(sdrngs[node]);
+	if (unlikely(!sdrng)) {
+		lrng_drngs_numa_alloc();
+		return &lrng_sdrng_init;
+	}
+
+	/* Pairs with smp_wmb in _lrng_drngs_numa_alloc */
+	smp_rmb();
+	if (!sdrng->fully_seeded)
+		return &lrng_sdrng_init;
+
+	return sdrng;
+}
+
+/**
+ * Reseed the atomic DRNG from the secondary DRNG of the NUMA node the work
+ * executes on. We can obtain random numbers from the secondary DRNG as the
+ * lock type chosen by lrng_sdrng_get is usable in the worker.
+ */
+static void lrng_sdrng_atomic_reseed_work(struct work_struct *work)
+{
+	struct lrng_sdrng *sdrng_atomic = &lrng_sdrng_atomic;
+	u8 seedbuf[LRNG_DRNG_SECURITY_STRENGTH_BYTES]
+						__aligned(LRNG_KCAPI_ALIGN);
 	unsigned long flags = 0;
+	int ret;
+
+	lrng_seed_latency(sdrng_atomic->reseed_work_queued);
+
+	/*
+	 * The atomic DRNG is identical to the parent DRNG until the DRNG
+	 * backend is switched -- it is reseeded together with its parent.
+	 */
+	if (lrng_sdrng_is_atomic(lrng_sdrng_node(numa_node_id()))) {
+		lrng_sdrng_lock(sdrng_atomic, &flags);
+		sdrng_atomic->last_seeded = jiffies;
+		sdrng_atomic->bytes = 0;
+		sdrng_atomic->force_reseed = false;
+		lrng_sdrng_unlock(sdrng_atomic, &flags);
+		return;
+	}
+
+	ret = lrng_sdrng_get(seedbuf, sizeof(seedbuf));
+	if (ret < 0) {
+		pr_warn("Error generating random numbers for atomic DRNG: %d\n",
+			ret);
+	} else {
+		lrng_sdrng_inject(sdrng_atomic, seedbuf, ret, true);
+		atomic64_inc(&lrng_seed_level_seeds[LRNG_SEED_LEVEL_NODE]);
+		sdrng_atomic->force_reseed = false;
+	}
+
+	memzero_explicit(seedbuf, sizeof(seedbuf));
+}
+
+/************************ Per-group secondary DRNGs **************************/
+
+/*
+ * Opt-in isolation of DRNG consumers: when enabled, callers of a cgroup or of
+ * a user or network namespace other than the initial one obtain their random
+ * numbers from a secondary DRNG of their group. That DRNG is seeded from the
+ * secondary DRNG of the NUMA node and only contended by members of the group,
+ * so a noisy neighbour cannot starve other groups of DRNG throughput.
+ *
+ * Group DRNGs are created on first use, limited to group_drng_max instances
+ * and released once they are idle for LRNG_GROUP_DRNG_IDLE seconds. The hash
+ * table is updated under the lrng_crypto_cb_update lock and read under RCU.
+ */
+enum lrng_group_mode {
+	LRNG_GROUP_NONE,	/* All callers use the NUMA node DRNG */
+	LRNG_GROUP_CGROUP,	/* One DRNG per cgroup v2 */
+	LRNG_GROUP_USER_NS,	/* One DRNG per user namespace */
+	LRNG_GROUP_NET_NS,	/* One DRNG per network namespace */
+};
+
+static u32 group_drng = LRNG_GROUP_NONE;
+module_param(group_drng, uint, 0444);
+MODULE_PARM_DESC(group_drng, "Separate secondary DRNG per group of callers "
+			     "(0 = disabled, 1 = cgroup, 2 = user namespace, "
+			     "3 = network namespace)");
+
+static u32 group_drng_max = 64;
+module_param(group_drng_max, uint, 0644);
+MODULE_PARM_DESC(group_drng_max, "Maximum number of per-group DRNGs");
+
+#define LRNG_GROUP_DRNG_IDLE	60
+
+struct lrng_group_drng {
+	struct hlist_node list;
+	struct rcu_head rcu;
+	struct kref ref;			/* Table and user references */
+	u64 id;					/* Identifier of group */
+	unsigned long last_used;		/* Last time DRNG was used */
+	atomic64_t requests;			/* Number of get requests */
+	atomic64_t bytes;			/* Number of generated bytes */
+	struct lrng_sdrng sdrng;
+};
+
+static DEFINE_HASHTABLE(lrng_group_drngs, 6);
+static u32 lrng_group_drngs_num;
+
+static void lrng_group_drngs_gc(struct work_struct *work);
+static DECLARE_DELAYED_WORK(lrng_group_drngs_gc_work, lrng_group_drngs_gc);
+
+/* Identify the group of the caller, return false for the initial group */
+static bool lrng_group_id(u64 *id)
+{
+	switch (group_drng) {
+#ifdef CONFIG_CGROUPS
+	case LRNG_GROUP_CGROUP: {
+		struct cgroup *cgrp;
+
+		rcu_read_lock();
+		cgrp = task_dfl_cgroup(current);
+		*id = cgroup_id(cgrp);
+		rcu_read_unlock();
+		return cgrp != &cgrp_dfl_root.cgrp;
+	}
+#endif
+#ifdef CONFIG_USER_NS
+	case LRNG_GROUP_USER_NS: {
+		struct user_namespace *ns = current_user_ns();
+
+		*id = ns->ns.inum;
+		return ns != &init_user_ns;
+	}
+#endif
+#ifdef CONFIG_NET_NS
+	case LRNG_GROUP_NET_NS: {
+		struct nsproxy *nsproxy = current->nsproxy;
+
+		/* Exiting tasks have no namespaces any more */
+		if (!nsproxy)
+			return false;
+		*id = nsproxy->net_ns->ns.inum;
+		return nsproxy->net_ns != &init_net;
+	}
+#endif
+	default:
+		return false;
+	}
+}
+
+static void lrng_group_drng_free(struct lrng_group_drng *grp)
+{
+	grp->sdrng.crypto_cb->lrng_drng_dealloc(grp->sdrng.sdrng);
+	kfree_rcu(grp, rcu);
+}
+
+/*
+ * Release last reference -- the table reference is dropped only after the
+ * garbage collection unhashed the DRNG with lrng_crypto_cb_update held. A
+ * DRNG backend switch therefore cannot reach the DRNG any more and the
+ * release does not need lrng_crypto_cb_update which the caller may hold.
+ * Lockless lookups still referring to the entry are covered by kfree_rcu.
+ */
+static void lrng_group_drng_release(struct kref *ref)
+{
+	lrng_group_drng_free(container_of(ref, struct lrng_group_drng, ref));
+}
+
+static void lrng_group_drng_put(struct lrng_group_drng *grp)
+{
+	kref_put(&grp->ref, lrng_group_drng_release);
+}
+
+static inline void lrng_sdrng_reset(struct lrng_sdrng *sdrng);
+static void *lrng_drng_alloc_node(const struct lrng_crypto_cb *crypto_cb,
+				  int node);
+
+static struct lrng_group_drng *lrng_group_drng_alloc(u64 id)
+{
+	struct lrng_group_drng *grp;
 	int node = numa_node_id();
-	u32 processed = 0;
+	void *drng;
 
-	if (!outbuf || !outbuflen)
-		return 0;
+	/*
+	 * The caller may already hold the lock when generating random numbers
+	 * during a DRNG backend switch -- use the node DRNG in this case.
+	 */
+	if (!mutex_trylock(&lrng_crypto_cb_update))
+		return NULL;
 
-	outbuflen = min_t(size_t, outbuflen, INT_MAX);
+	/* Another caller of the group may have been faster */
+	hash_for_each_possible(lrng_group_drngs, grp, list, id) {
+		if (grp->id == id) {
+			kref_get(&grp->ref);
+			goto out;
+		}
+	}
 
-	lrng_drngs_init_cc20();
+	grp = NULL;
+	if (lrng_group_drngs_num >= group_drng_max)
+		goto out;
 
-	if (unlikely(in_atomic() || in_interrupt()))
-		sdrng = &lrng_sdrng_atomic;
-	else if (lrng_sdrng && lrng_sdrng[node]->fully_seeded)
-		sdrng = lrng_sdrng[node];
-	else
-		sdrng = &lrng_sdrng_init;
+	grp = kzalloc_node(sizeof(*grp), GFP_KERNEL, node);
+	if (!grp)
+		goto out;
+
+	grp->sdrng.crypto_cb = lrng_sdrng_init.crypto_cb;
+	drng = lrng_drng_alloc_node(grp->sdrng.crypto_cb, node);
+	if (IS_ERR(drng)) {
+		kfree(grp);
+		grp = NULL;
+		goto out;
+	}
+
+	grp->sdrng.sdrng = drng;
+	grp->sdrng.node = node;
+	grp->sdrng.group_drng = true;
+	init_waitqueue_head(&grp->sdrng.small_wait);
+	mutex_init(&grp->sdrng.lock);
+	spin_lock_init(&grp->sdrng.spin_lock);
+	lrng_sdrng_reset(&grp->sdrng);
+
+	grp->id = id;
+	grp->last_used = jiffies;
+	/* One reference for the table, one for the caller */
+	kref_init(&grp->ref);
+	kref_get(&grp->ref);
+	hash_add_rcu(lrng_group_drngs, &grp->list, id);
+	if (!lrng_group_drngs_num++)
+		queue_delayed_work(lrng_wq ?: system_unbound_wq,
+				   &lrng_group_drngs_gc_work,
+				   LRNG_GROUP_DRNG_IDLE * HZ);
+	pr_debug("secondary DRNG for group %llu allocated\n", id);
+
+out:
+	mutex_unlock(&lrng_crypto_cb_update);
+	return grp;
+}
+
+/* Obtain a reference to the DRNG of the caller's group, if any */
+static struct lrng_group_drng *lrng_group_drng_get(void)
+{
+	struct lrng_group_drng *grp;
+	u64 id;
+
+	if (likely(group_drng == LRNG_GROUP_NONE) || !lrng_group_id(&id))
+		return NULL;
+
+	/* Separate instances only help if they can generate concurrently */
+	if (!(lrng_drng_caps(READ_ONCE(lrng_sdrng_init.crypto_cb))->flags &
+	      LRNG_DRNG_CAP_PARALLEL))
+		return NULL;
+
+	rcu_read_lock();
+	hash_for_each_possible_rcu(lrng_group_drngs, grp, list, id) {
+		if (grp->id == id && kref_get_unless_zero(&grp->ref)) {
+			rcu_read_unlock();
+			goto out;
+		}
+	}
+	rcu_read_unlock();
+
+	grp = lrng_group_drng_alloc(id);
+	if (!grp)
+		return NULL;
+
+out:
+	WRITE_ONCE(grp->last_used, jiffies);
+	return grp;
+}
+
+/* Release group DRNGs which were not used for LRNG_GROUP_DRNG_IDLE seconds */
+static void lrng_group_drngs_gc(struct work_struct *work)
+{
+	struct lrng_group_drng *grp;
+	struct hlist_node *tmp;
+	int bkt;
+
+	mutex_lock(&lrng_crypto_cb_update);
+	hash_for_each_safe(lrng_group_drngs, bkt, tmp, grp, list) {
+		if (time_before(jiffies, READ_ONCE(grp->last_used) +
+					 LRNG_GROUP_DRNG_IDLE * HZ))
+			continue;
+
+		hash_del_rcu(&grp->list);
+		lrng_group_drngs_num--;
+		pr_debug("secondary DRNG for group %llu released\n", grp->id);
+		kref_put(&grp->ref, lrng_group_drng_release);
+	}
+	if (lrng_group_drngs_num)
+		queue_delayed_work(lrng_wq ?: system_unbound_wq,
+				   &lrng_group_drngs_gc_work,
+				   LRNG_GROUP_DRNG_IDLE * HZ);
+	mutex_unlock(&lrng_crypto_cb_update);
+}
+
+/* Force a reseed of all group DRNGs */
+static void lrng_group_drngs_force_reseed(void)
+{
+	struct lrng_group_drng *grp;
+	int bkt;
+
+	rcu_read_lock();
+	hash_for_each_rcu(lrng_group_drngs, bkt, grp, list)
+		grp->sdrng.force_reseed = true;
+	rcu_read_unlock();
+}
+
+static int lrng_sdrng_generate(struct lrng_sdrng *sdrng,
+			       u8 *outbuf, u32 outbuflen);
+
+/*
+ * Seed function for group DRNGs: the seed is obtained from the fully seeded
+ * secondary DRNG of the local NUMA node.
+ */
+static int lrng_group_drng_seed(u8 *outbuf, u32 outbuflen, bool fullentropy,
+				bool drain)
+{
+	struct lrng_sdrng *sdrng = lrng_sdrng_node(numa_node_id());
+
+	if (!sdrng->fully_seeded)
+		return -EAGAIN;
+
+	return lrng_sdrng_generate(sdrng, outbuf, outbuflen);
+}
+
+/*
+ * Generate random numbers from the given secondary DRNG in chunks sized by
+ * the capability hints of its backend, reseeding it when due. Backends using
+ * the FPU are never invoked from interrupt context -- interrupt context uses
+ * the atomic DRNG which always is the ChaCha20 DRNG.
+ *
+ * The lock of a DRNG protected by a mutex is shared fairly: a large request
+ * steps back before each chunk while small requests are queued for the lock
+ * so that they do not wait behind a streaming reader. The wait is bounded to
+ * one jiffy per chunk to prevent starving the large request.
+ */
+static int lrng_sdrng_generate(struct lrng_sdrng *sdrng,
+			       u8 *outbuf, u32 outbuflen)
+{
+	unsigned long flags = 0;
+	u32 processed = 0;
+	bool fair = !lrng_sdrng_is_atomic(sdrng);
+	bool small = outbuflen <= LRNG_DRNG_SMALL_REQSIZE;
+
+	/*
+	 * Interrupt context is served by the atomic DRNG which always is the
+	 * ChaCha20 DRNG. Guard that an FPU backend is never reached from it.
+	 */
+	if (WARN_ON_ONCE(in_interrupt() &&
+			 (lrng_drng_caps(READ_ONCE(sdrng->crypto_cb))->flags &
+			  LRNG_DRNG_CAP_FPU)))
+		return -EFAULT;
 
 	while (outbuflen) {
-		u32 todo = min_t(u32, outbuflen, LRNG_DRNG_MAX_REQSIZE);
+		u32 todo = lrng_drng_chunk(READ_ONCE(sdrng->crypto_cb),
+					   outbuflen);
 		int ret;
 
-		/* All but the atomic DRNG are seeded during generation */
-		if (atomic_dec_and_test(&sdrng->requests) ||
-		    sdrng->force_reseed ||
-		    time_after(jiffies, sdrng->last_seeded +
-			       lrng_sdrng_reseed_max_time * HZ)) {
-			if (likely(sdrng != &lrng_sdrng_atomic))
+		/*
+		 * Once fully seeded, the reseed is performed by the reseed
+		 * scheduler and not inline with the request. The atomic DRNG
+		 * is always reseeded asynchronously from its parent DRNG.
+		 * Group DRNGs are reseeded inline from their node DRNG which
+		 * does not touch the primary DRNG.
+		 */
+		if (lrng_sdrng_reseed_due(sdrng)) {
+			if (sdrng->group_drng)
+				lrng_sdrng_seed(sdrng, lrng_group_drng_seed);
+			else if (unlikely(sdrng == &lrng_sdrng_atomic) ||
+				 sdrng->fully_seeded)
+				lrng_sdrng_reseed_schedule(sdrng);
+			else
 				lrng_sdrng_seed(sdrng, lrng_pdrng_seed);
 		}
 
+		if (fair && !small && atomic_read(&sdrng->small_waiters))
+			wait_event_timeout(sdrng->small_wait,
+					   !atomic_read(&sdrng->small_waiters),
+					   1);
+
+		if (fair && small)
+			atomic_inc(&sdrng->small_waiters);
 		lrng_sdrng_lock(sdrng, &flags);
+		if (fair && small && atomic_dec_and_test(&sdrng->small_waiters))
+			wake_up(&sdrng->small_wait);
 		ret = sdrng->crypto_cb->lrng_drng_generate_helper(
 					sdrng->sdrng, outbuf + processed, todo);
+		if (ret > 0) {
+			unsigned long charge = max_t(unsigned long, ret,
+					LRNG_DRNG_SECURITY_STRENGTH_BYTES);
+
+			sdrng->bytes = (sdrng->bytes > ULONG_MAX - charge) ?
+				       ULONG_MAX : sdrng->bytes + charge;
+		}
 		lrng_sdrng_unlock(sdrng, &flags);
 		if (ret <= 0) {
 			pr_warn("getting random data from secondary DRNG "
@@ -1423,11 +2913,258 @@ static int lrng_sdrng_get(u8 *outbuf, u32 outbuflen)
 	return processed;
 }
 
+/**************************** Keystream prefetch *****************************/
+
+/*
+ * Optional per-CPU buffers of random numbers generated ahead of time by a
+ * SCHED_IDLE kernel thread, i.e. using otherwise idle CPU time. Bursts of
+ * small requests are served from the buffer of the local CPU without invoking
+ * the DRNG. The data is taken from the secondary DRNG of the CPU's NUMA node
+ * once it is fully seeded. Buffers are discarded when a secondary DRNG is
+ * reseeded, when they are older than LRNG_PREFETCH_LIFETIME seconds and when
+ * their CPU goes offline. Data handed out is wiped from the buffer.
+ */
+#define LRNG_PREFETCH_MAX	1024
+#define LRNG_PREFETCH_LIFETIME	10
+
+static u32 prefetch_bytes = 0;
+module_param(prefetch_bytes, uint, 0444);
+MODULE_PARM_DESC(prefetch_bytes, "Size of per-CPU buffer of random numbers "
+				 "generated in idle time (0 = disabled, maximum "
+				 "1024)");
+
+struct lrng_prefetch {
+	u8 buf[LRNG_PREFETCH_MAX];
+	u32 avail;				/* Bytes left in buf */
+	u32 gen;				/* Generation of data */
+	unsigned long filled;			/* Time buf was filled */
+	spinlock_t lock;
+};
+
+static DEFINE_PER_CPU(struct lrng_prefetch, lrng_prefetch) = {
+	.lock = __SPIN_LOCK_UNLOCKED(lrng_prefetch.lock),
+};
+static atomic_t lrng_prefetch_gen = ATOMIC_INIT(0);
+static atomic_t lrng_prefetch_wanted = ATOMIC_INIT(0);
+static DECLARE_WAIT_QUEUE_HEAD(lrng_prefetch_wait);
+
+/* Discard buffer content, caller must hold the buffer lock */
+static inline void lrng_prefetch_wipe(struct lrng_prefetch *pf)
+{
+	memzero_explicit(pf->buf, pf->avail);
+	pf->avail = 0;
+}
+
+static inline bool lrng_prefetch_stale(struct lrng_prefetch *pf)
+{
+	return pf->gen != atomic_read(&lrng_prefetch_gen) ||
+	       time_after(jiffies, pf->filled + LRNG_PREFETCH_LIFETIME * HZ);
+}
+
+static void lrng_prefetch_kick(void)
+{
+	atomic_set(&lrng_prefetch_wanted, 1);
+	/* The thread also wakes up periodically to serve atomic callers */
+	if (!in_atomic() && !irqs_disabled())
+		wake_up_interruptible(&lrng_prefetch_wait);
+}
+
+/* Invalidate all buffered data -- called when a secondary DRNG is reseeded */
+static void lrng_prefetch_invalidate(void)
+{
+	if (!prefetch_bytes)
+		return;
+
+	atomic_inc(&lrng_prefetch_gen);
+	lrng_prefetch_kick();
+}
+
+/* Serve a small request from the buffer of the local CPU */
+static bool lrng_prefetch_get(u8 *outbuf, u32 outbuflen)
+{
+	struct lrng_prefetch *pf;
+	unsigned long flags;
+	bool served = false, low;
+
+	if (!prefetch_bytes)
+		return false;
+
+	local_irq_save(flags);
+	pf = this_cpu_ptr(&lrng_prefetch);
+	spin_lock(&pf->lock);
+	if (pf->avail && lrng_prefetch_stale(pf))
+		lrng_prefetch_wipe(pf);
+	if (pf->avail >= outbuflen) {
+		pf->avail -= outbuflen;
+		memcpy(outbuf, pf->buf + pf->avail, outbuflen);
+		memzero_explicit(pf->buf + pf->avail, outbuflen);
+		served = true;
+	}
+	low = pf->avail < min_t(u32, prefetch_bytes, LRNG_PREFETCH_MAX) / 2;
+	spin_unlock(&pf->lock);
+	local_irq_restore(flags);
+
+	if (low)
+		lrng_prefetch_kick();
+
+	return served;
+}
+
+/* Refill the buffer of the given CPU if it is stale or drained by half */
+static void lrng_prefetch_fill(unsigned int cpu, u8 *buf)
+{
+	struct lrng_prefetch *pf = per_cpu_ptr(&lrng_prefetch, cpu);
+	struct lrng_sdrng *sdrng = lrng_sdrng_node(cpu_to_node(cpu));
+	u32 len = min_t(u32, prefetch_bytes, LRNG_PREFETCH_MAX);
+	u32 gen = atomic_read(&lrng_prefetch_gen);
+	unsigned long flags;
+	bool fill;
+	int ret;
+
+	if (!sdrng->fully_seeded)
+		return;
+
+	spin_lock_irqsave(&pf->lock, flags);
+	fill = lrng_prefetch_stale(pf) || pf->avail < len / 2;
+	spin_unlock_irqrestore(&pf->lock, flags);
+	if (!fill)
+		return;
+
+	ret = lrng_sdrng_generate(sdrng, buf, len);
+	if (ret == len) {
+		spin_lock_irqsave(&pf->lock, flags);
+		/* Do not install data generated before an invalidation */
+		if (cpu_online(cpu) && gen == atomic_read(&lrng_prefetch_gen)) {
+			memcpy(pf->buf, buf, len);
+			pf->avail = len;
+			pf->gen = gen;
+			pf->filled = jiffies;
+		}
+		spin_unlock_irqrestore(&pf->lock, flags);
+	}
+	memzero_explicit(buf, len);
+}
+
+static int lrng_prefetch_thread(void *unused)
+{
+	static const struct sched_param param = { .sched_priority = 0 };
+	static u8 buf[LRNG_PREFETCH_MAX] __aligned(LRNG_KCAPI_ALIGN);
+
+	sched_setscheduler_nocheck(current, SCHED_IDLE, &param);
+
+	while (!kthread_should_stop()) {
+		unsigned int cpu;
+
+		wait_event_interruptible_timeout(lrng_prefetch_wait,
+				atomic_xchg(&lrng_prefetch_wanted, 0) ||
+				kthread_should_stop(),
+				LRNG_PREFETCH_LIFETIME * HZ);
+
+		get_online_cpus();
+		for_each_online_cpu(cpu)
+			lrng_prefetch_fill(cpu, buf);
+		put_online_cpus();
+	}
+
+	return 0;
+}
+
+/* Wipe the buffer of a CPU going offline */
+static int lrng_prefetch_cpu_offline(unsigned int cpu)
+{
+	struct lrng_prefetch *pf = per_cpu_ptr(&lrng_prefetch, cpu);
+	unsigned long flags;
+
+	spin_lock_irqsave(&pf->lock, flags);
+	lrng_prefetch_wipe(pf);
+	spin_unlock_irqrestore(&pf->lock, flags);
+
+	return 0;
+}
+
+static void __init lrng_prefetch_init(void)
+{
+	struct task_struct *task;
+
+	if (!prefetch_bytes)
+		return;
+
+	if (prefetch_bytes > LRNG_PREFETCH_MAX) {
+		pr_warn("prefetch buffer size limited to %u bytes\n",
+			LRNG_PREFETCH_MAX);
+		prefetch_bytes = LRNG_PREFETCH_MAX;
+	}
+
+	task = kthread_run(lrng_prefetch_thread, NULL, "lrng_prefetch");
+	if (IS_ERR(task)) {
+		pr_warn("could not start prefetch thread (%ld)\n",
+			PTR_ERR(task));
+		prefetch_bytes = 0;
+	}
+}
+
+/**
+ * Get random data out of the secondary DRNG which is reseeded frequently. In
+ * the worst case, the DRNG may generate the reseed budget of its tier in bytes
+ * plus one request without being reseeded.
+ *
+ * If the DRNG is not yet initialized, use the initial RNG output.
+ *
+ * @outbuf: buffer for storing random data
+ * @outbuflen: length of outbuf
+ * @return: < 0 in error case (DRNG generation or update failed)
+ *	    >=0 returning the returned number of bytes
+ */
+static int lrng_sdrng_get(u8 *outbuf, u32 outbuflen)
+{
+	struct lrng_group_drng *grp = NULL;
+	struct lrng_sdrng *sdrng;
+	int ret;
+
+	if (!outbuf || !outbuflen)
+		return 0;
+
+	outbuflen = min_t(size_t, outbuflen, INT_MAX);
+
+	lrng_drngs_init_cc20();
+
+	if (outbuflen <= LRNG_DRNG_SMALL_REQSIZE &&
+	    group_drng == LRNG_GROUP_NONE && lrng_prefetch_get(outbuf, outbuflen))
+		return outbuflen;
+
+	if (unlikely(in_atomic() || in_interrupt()))
+		return lrng_sdrng_generate(&lrng_sdrng_atomic, outbuf,
+					   outbuflen);
+
+	sdrng = lrng_sdrng_node(numa_node_id());
+
+	/* Group DRNGs are only used once they can be fully seeded */
+	if (sdrng->fully_seeded)
+		grp = lrng_group_drng_get();
+	if (grp && !grp->sdrng.fully_seeded)
+		lrng_sdrng_seed(&grp->sdrng, lrng_group_drng_seed);
+	if (grp && !grp->sdrng.fully_seeded) {
+		lrng_group_drng_put(grp);
+		grp = NULL;
+	}
+	if (!grp)
+		return lrng_sdrng_generate(sdrng, outbuf, outbuflen);
+
+	ret = lrng_sdrng_generate(&grp->sdrng, outbuf, outbuflen);
+	if (ret > 0) {
+		atomic64_inc(&grp->requests);
+		atomic64_add(ret, &grp->bytes);
+	}
+	lrng_group_drng_put(grp);
+
+	return ret;
+}
+
 /****************************** DRNG allocation ******************************/
 
 static inline void lrng_sdrng_reset(struct lrng_sdrng *sdrng)
 {
-	atomic_set(&sdrng->requests, LRNG_DRNG_RESEED_THRESH);
+	sdrng->bytes = 0;
 	sdrng->last_seeded = jiffies;
 	sdrng->fully_seeded = false;
 	sdrng->force_reseed = true;
@@ -1475,109 +3212,284 @@ static void lrng_drngs_init_cc20(void)
 			LRNG_IRQ_OVERSAMPLING_FACTOR);
 	}
 
-	lrng_sdrng_reset(&lrng_sdrng_init);
-	lrng_cc20_init_state(&secondary_chacha20);
-	lrng_sdrng_unlock(&lrng_sdrng_init, &flags);
+	lrng_sdrng_reset(&lrng_sdrng_init);
+	lrng_cc20_init_state(&secondary_chacha20);
+	lrng_sdrng_unlock(&lrng_sdrng_init, &flags);
+
+	lrng_sdrng_lock(&lrng_sdrng_atomic, &flags);
+	lrng_sdrng_reset(&lrng_sdrng_atomic);
+	/*
+	 * We do not initialize the state of the atomic DRNG as it is identical
+	 * to the secondary DRNG at this point.
+	 */
+	lrng_sdrng_unlock(&lrng_sdrng_atomic, &flags);
+
+	mutex_lock(&lrng_pdrng.lock);
+	lrng_pdrng_reset();
+	lrng_cc20_init_state(&primary_chacha20);
+	INIT_WORK(&lrng_pdrng.lrng_seed_work, lrng_sdrng_seed_work);
+	atomic_set(&lrng_pdrng_avail, 1);
+	mutex_unlock(&lrng_pdrng.lock);
+}
+
+struct lrng_drng_alloc_req {
+	const struct lrng_crypto_cb *crypto_cb;
+	int node;
+};
+
+static long lrng_drng_alloc_on_cpu(void *arg)
+{
+	struct lrng_drng_alloc_req *req = arg;
+
+	return (long)req->crypto_cb->lrng_drng_alloc(
+				LRNG_DRNG_SECURITY_STRENGTH_BYTES, req->node);
+}
+
+/**
+ * Allocate a DRNG instance with its memory local to the given NUMA node. The
+ * backend receives the node as hint. In addition, the allocation is executed
+ * on a CPU of that node so that memory the backend cannot place explicitly,
+ * such as the internal state of kernel crypto API ciphers, is allocated
+ * node-locally by the default memory policy, too.
+ */
+static void *lrng_drng_alloc_node(const struct lrng_crypto_cb *crypto_cb,
+				  int node)
+{
+	struct lrng_drng_alloc_req req = {
+		.crypto_cb	= crypto_cb,
+		.node		= node,
+	};
+	unsigned int cpu;
+
+	if (node != NUMA_NO_NODE) {
+		cpu = cpumask_any_and(cpumask_of_node(node), cpu_online_mask);
+		if (cpu < nr_cpu_ids)
+			return (void *)work_on_cpu_safe(cpu,
+							lrng_drng_alloc_on_cpu,
+							&req);
+	}
+
+	return (void *)lrng_drng_alloc_on_cpu(&req);
+}
+
+/*
+ * Is the NUMA node populated with memory or CPUs that may request random
+ * numbers and therefore warrants its own secondary DRNG?
+ */
+static inline bool lrng_node_populated(int node)
+{
+	return node_online(node) &&
+	       (node_state(node, N_MEMORY) ||
+		cpumask_intersects(cpumask_of_node(node), cpu_online_mask));
+}
+
+/**
+ * Allocate the secondary DRNG for one NUMA node. The state is not seeded.
+ * The caller must hold the lrng_crypto_cb_update lock.
+ */
+static struct lrng_sdrng *lrng_sdrng_node_alloc(int node)
+{
+	struct lrng_sdrng *sdrng;
+	void *drng;
+
+	sdrng = kzalloc_node(sizeof(struct lrng_sdrng), GFP_KERNEL, node);
+	if (!sdrng)
+		return ERR_PTR(-ENOMEM);
+
+	sdrng->crypto_cb = lrng_sdrng_init.crypto_cb;
+	drng = lrng_drng_alloc_node(sdrng->crypto_cb, node);
+	if (IS_ERR(drng)) {
+		kfree(sdrng);
+		return ERR_CAST(drng);
+	}
+	sdrng->sdrng = drng;
+
+	sdrng->node = node;
+	timer_setup(&sdrng->reseed_timer, lrng_sdrng_reseed_timer, 0);
+	INIT_WORK(&sdrng->reseed_work, lrng_sdrng_reseed_work);
+	init_waitqueue_head(&sdrng->small_wait);
+	mutex_init(&sdrng->lock);
+	spin_lock_init(&sdrng->spin_lock);
+
+	/*
+	 * No reseeding of NUMA DRNGs from previous DRNGs as this
+	 * would complicate the code. Let it simply reseed.
+	 */
+	lrng_sdrng_reset(sdrng);
+
+	return sdrng;
+}
+
+/**
+ * Retire the secondary DRNG of a NUMA node that went offline: it is marked
+ * as not seeded which causes readers to no longer select it and forces a
+ * reseed from the primary DRNG before it is used again. The retired flag
+ * stops a reseed work that is still running from re-arming the reseed timer.
+ * The caller must hold the lrng_crypto_cb_update lock.
+ */
+static void lrng_sdrng_node_retire(struct lrng_sdrng *sdrng, int node)
+{
+	unsigned long flags = 0;
+
+	node_clear(node, lrng_sdrng_nodes);
+	WRITE_ONCE(sdrng->retired, true);
+	cancel_work_sync(&sdrng->reseed_work);
+	del_timer_sync(&sdrng->reseed_timer);
+
+	lrng_sdrng_lock(sdrng, &flags);
+	lrng_sdrng_reset(sdrng);
+	lrng_sdrng_unlock(sdrng, &flags);
+
+	lrng_pool.numa_drngs--;
+	pr_info("secondary DRNG for NUMA node %d retired\n", node);
+}
+
+/**
+ * Seed a secondary DRNG that was just put into service. If the primary DRNG
+ * is not yet fully seeded or busy, the interrupt noise source triggers the
+ * seeding via lrng_sdrng_seed_work.
+ */
+static void lrng_sdrng_node_seed(struct lrng_sdrng *sdrng, int node)
+{
+	lrng_pool.all_online_numa_node_seeded = false;
 
-	lrng_sdrng_lock(&lrng_sdrng_atomic, &flags);
-	lrng_sdrng_reset(&lrng_sdrng_atomic);
-	/*
-	 * We do not initialize the state of the atomic DRNG as it is identical
-	 * to the secondary DRNG at this point.
-	 */
-	lrng_sdrng_unlock(&lrng_sdrng_atomic, &flags);
+	if (!lrng_pdrng.pdrng_fully_seeded)
+		return;
 
-	mutex_lock(&lrng_pdrng.lock);
-	lrng_pdrng_reset();
-	lrng_cc20_init_state(&primary_chacha20);
-	INIT_WORK(&lrng_pdrng.lrng_seed_work, lrng_sdrng_seed_work);
-	atomic_set(&lrng_pdrng_avail, 1);
-	mutex_unlock(&lrng_pdrng.lock);
+	lrng_sdrng_seed(sdrng, lrng_pdrng_seed);
+	if (sdrng->fully_seeded)
+		pr_debug("secondary DRNG for NUMA node %d seeded\n", node);
 }
 
 /**
- * Allocate the data structures for the per-NUMA node DRNGs
- * The caller must hold the lrng_crypto_cb_update lock.
+ * Allocate the data structures for the per-NUMA node DRNGs and bring them in
+ * line with the populated NUMA nodes: nodes that came online after the
+ * initial allocation receive their DRNG and nodes that went offline have
+ * their DRNG retired.
  */
 static void _lrng_drngs_numa_alloc(struct work_struct *work)
 {
 	struct lrng_sdrng **sdrngs;
-	u32 node;
-	bool init_sdrng_used = false;
+	int node;
 
 	mutex_lock(&lrng_crypto_cb_update);
 
 	lrng_drngs_init_cc20();
 
-	/* per-NUMA-node DRNGs are already present */
-	if (lrng_sdrng)
-		goto unlock;
+	sdrngs = lrng_sdrng;
+	if (!sdrngs) {
+		sdrngs = kcalloc(nr_node_ids, sizeof(void *),
+				 GFP_KERNEL|__GFP_NOFAIL);
 
-	sdrngs = kcalloc(nr_node_ids, sizeof(void *), GFP_KERNEL|__GFP_NOFAIL);
-	for_each_online_node(node) {
-		struct lrng_sdrng *sdrng;
+		/* The initial secondary DRNG serves the first online node */
+		lrng_sdrng_init.node = first_online_node;
+		sdrngs[first_online_node] = &lrng_sdrng_init;
+		node_set(first_online_node, lrng_sdrng_nodes);
 
-		if (!init_sdrng_used) {
-			sdrngs[node] = &lrng_sdrng_init;
-			init_sdrng_used = true;
-			continue;
-		}
+		/* Ensure that all NUMA nodes receive changed memory here. */
+		mb();
+		WRITE_ONCE(lrng_sdrng, sdrngs);
+	}
 
-		sdrng = kmalloc_node(sizeof(struct lrng_sdrng),
-				     GFP_KERNEL|__GFP_NOFAIL, node);
-		memset(sdrng, 0, sizeof(lrng_sdrng));
+	for_each_node(node) {
+		struct lrng_sdrng *sdrng = sdrngs[node];
 
-		sdrng->crypto_cb = lrng_sdrng_init.crypto_cb;
-		sdrng->sdrng = sdrng->crypto_cb->lrng_drng_alloc(
-					LRNG_DRNG_SECURITY_STRENGTH_BYTES);
-		if (IS_ERR(sdrng->sdrng)) {
-			kfree(sdrng);
-			goto err;
+		if (!lrng_node_populated(node)) {
+			if (sdrng && sdrng != &lrng_sdrng_init &&
+			    node_isset(node, lrng_sdrng_nodes))
+				lrng_sdrng_node_retire(sdrng, node);
+			continue;
 		}
 
-		mutex_init(&sdrng->lock);
-		spin_lock_init(&sdrng->spin_lock);
+		if (node_isset(node, lrng_sdrng_nodes))
+			continue;
 
-		/*
-		 * No reseeding of NUMA DRNGs from previous DRNGs as this
-		 * would complicate the code. Let it simply reseed.
-		 */
-		lrng_sdrng_reset(sdrng);
-		sdrngs[node] = sdrng;
+		if (!sdrng) {
+			sdrng = lrng_sdrng_node_alloc(node);
+			if (IS_ERR(sdrng)) {
+				pr_warn("could not allocate secondary DRNG for "
+					"NUMA node %d (%ld)\n", node,
+					PTR_ERR(sdrng));
+				continue;
+			}
+
+			/* Publish fully initialized DRNG to readers. */
+			smp_wmb();
+			WRITE_ONCE(sdrngs[node], sdrng);
+			pr_info("secondary DRNG for NUMA node %d allocated\n",
+				node);
+		}
 
+		WRITE_ONCE(sdrng->retired, false);
+		node_set(node, lrng_sdrng_nodes);
 		lrng_pool.numa_drngs++;
-		pr_info("secondary DRNG for NUMA node %d allocated\n", node);
+		lrng_sdrng_node_seed(sdrng, node);
 	}
 
-	/* Ensure that all NUMA nodes receive changed memory here. */
-	mb();
-
-	if (!cmpxchg(&lrng_sdrng, NULL, sdrngs))
-		goto unlock;
+	mutex_unlock(&lrng_crypto_cb_update);
+}
 
-err:
-	for_each_online_node(node) {
-		struct lrng_sdrng *sdrng = sdrngs[node];
+static DECLARE_WORK(lrng_drngs_numa_alloc_work, _lrng_drngs_numa_alloc);
 
-		if (sdrng == &lrng_sdrng_init)
-			continue;
+static void lrng_drngs_numa_alloc(void)
+{
+	queue_work(lrng_wq ? lrng_wq : system_unbound_wq,
+		   &lrng_drngs_numa_alloc_work);
+}
 
-		if (sdrng) {
-			sdrng->crypto_cb->lrng_drng_dealloc(sdrng->sdrng);
-			kfree(sdrng);
-		}
+#ifdef CONFIG_MEMORY_HOTPLUG
+/* A NUMA node gained its first or lost its last memory block */
+static int lrng_memory_callback(struct notifier_block *self,
+				unsigned long action, void *arg)
+{
+	struct memory_notify *mn = arg;
+
+	switch (action) {
+	case MEM_ONLINE:
+	case MEM_OFFLINE:
+		if (mn->status_change_nid >= 0)
+			lrng_drngs_numa_alloc();
+		break;
+	default:
+		break;
 	}
-	kfree(sdrngs);
 
-unlock:
-	mutex_unlock(&lrng_crypto_cb_update);
+	return NOTIFY_OK;
 }
 
-static DECLARE_WORK(lrng_drngs_numa_alloc_work, _lrng_drngs_numa_alloc);
+static struct notifier_block lrng_memory_nb = {
+	.notifier_call = lrng_memory_callback,
+};
+#endif /* CONFIG_MEMORY_HOTPLUG */
 
-static void lrng_drngs_numa_alloc(void)
+/* A CPU came online -- it may be the first one of a memoryless NUMA node */
+static int lrng_cpu_online(unsigned int cpu)
+{
+	struct lrng_sdrng **sdrngs = READ_ONCE(lrng_sdrng);
+	int node = cpu_to_node(cpu);
+
+	if (!sdrngs || !READ_ONCE(sdrngs[node]))
+		lrng_drngs_numa_alloc();
+
+	return 0;
+}
+
+static void lrng_drngs_numa_hotplug_init(void)
 {
-        schedule_work(&lrng_drngs_numa_alloc_work);
+	int ret;
+
+#ifdef CONFIG_MEMORY_HOTPLUG
+	ret = register_memory_notifier(&lrng_memory_nb);
+	if (ret)
+		pr_warn("could not register memory hotplug notifier (%d)\n",
+			ret);
+#endif
+
+	ret = cpuhp_setup_state_nocalls(CPUHP_AP_ONLINE_DYN, "char/lrng:online",
+					lrng_cpu_online,
+					lrng_prefetch_cpu_offline);
+	if (ret < 0)
+		pr_warn("could not register CPU hotplug callback (%d)\n", ret);
 }
 
 /******************************* DRNG switching ******************************/
@@ -1589,8 +3501,7 @@ static void lrng_sdrng_switch(struct lrng_sdrng *sdrng_store,
 	unsigned long flags = 0;
 	int ret;
 	u8 seed[LRNG_DRNG_SECURITY_STRENGTH_BYTES];
-	void *new_sdrng =
-			cb->lrng_drng_alloc(LRNG_DRNG_SECURITY_STRENGTH_BYTES);
+	void *new_sdrng = lrng_drng_alloc_node(cb, node);
 	void *old_sdrng;
 	bool reset_sdrng = !likely(atomic_read(&lrng_pdrng_avail));
 
@@ -1667,11 +3578,13 @@ static void lrng_sdrng_switch(struct lrng_sdrng *sdrng_store,
  */
 static int lrng_drngs_switch(const struct lrng_crypto_cb *cb)
 {
-	int ret;
+	struct lrng_group_drng *grp;
+	int ret, bkt;
 	u8 seed[LRNG_DRNG_SECURITY_STRENGTH_BYTES];
 	void *pdrng, *hash;
 
-	pdrng = cb->lrng_drng_alloc(LRNG_DRNG_SECURITY_STRENGTH_BYTES);
+	pdrng = cb->lrng_drng_alloc(LRNG_DRNG_SECURITY_STRENGTH_BYTES,
+				    NUMA_NO_NODE);
 	if (IS_ERR(pdrng))
 		return PTR_ERR(pdrng);
 
@@ -1729,22 +3642,175 @@ static int lrng_drngs_switch(const struct lrng_crypto_cb *cb)
 	if (lrng_sdrng) {
 		u32 node;
 
-		for_each_online_node(node) {
+		for_each_node(node) {
 			if (lrng_sdrng[node])
 				lrng_sdrng_switch(lrng_sdrng[node], cb, node);
 		}
 	} else
 		lrng_sdrng_switch(&lrng_sdrng_init, cb, 0);
 
+	/* Update group DRNGs, the table is stable under lrng_crypto_cb_update */
+	hash_for_each(lrng_group_drngs, bkt, grp, list)
+		lrng_sdrng_switch(&grp->sdrng, cb, grp->sdrng.node);
+
+	lrng_prefetch_invalidate();
+
 	atomic_set(&lrng_pdrng_avail, 1);
 
 	return 0;
 }
 
+/*
+ * Optional selection of the DRNG backend by a self-benchmark: every backend
+ * registering with lrng_set_drng_cb is instantiated once, seeded and used to
+ * generate LRNG_DRNG_BENCH_BYTES. The backend with the highest generate
+ * throughput that satisfies the policy is kept, similar to the algorithm
+ * selection of the XOR and RAID6 code. With policy drng_require_sp80090a, only
+ * SP800-90A DRBGs, i.e. kernel crypto API DRNGs named drbg_*, are eligible.
+ */
+static bool drng_autoselect = false;
+module_param(drng_autoselect, bool, 0444);
+MODULE_PARM_DESC(drng_autoselect, "Select fastest DRNG backend by benchmark");
+
+static bool drng_require_sp80090a = false;
+module_param(drng_require_sp80090a, bool, 0444);
+MODULE_PARM_DESC(drng_require_sp80090a,
+		 "Only select SP800-90A DRBG backends by benchmark");
+
+#define LRNG_DRNG_BENCH_BYTES	(4 * LRNG_DRNG_MAX_REQSIZE_BULK)
+#define LRNG_DRNG_BENCH_MAX	4
+
+/*
+ * The name is copied as the entry may be reported after the backend module
+ * is gone. The entry is removed when its backend is rejected or deregistered.
+ */
+struct lrng_drng_bench {
+	const struct lrng_crypto_cb *cb;
+	char name[CRYPTO_MAX_ALG_NAME];		/* Backend name */
+	u64 generate_mbps;			/* Generate throughput in MB/s */
+	u64 seed_ns;				/* Seed latency in ns */
+	bool eligible;				/* Backend matches policy */
+};
+
+/* Benchmark results, protected by lrng_crypto_cb_update */
+static struct lrng_drng_bench lrng_drng_bench[LRNG_DRNG_BENCH_MAX];
+static u32 lrng_drng_bench_num;
+
+static struct lrng_drng_bench *lrng_drng_bench_find(
+					const struct lrng_crypto_cb *cb)
+{
+	u32 i;
+
+	for (i = 0; i < lrng_drng_bench_num; i++) {
+		if (lrng_drng_bench[i].cb == cb)
+			return &lrng_drng_bench[i];
+	}
+
+	return NULL;
+}
+
+static void lrng_drng_bench_remove(const struct lrng_crypto_cb *cb)
+{
+	struct lrng_drng_bench *bench = lrng_drng_bench_find(cb);
+
+	if (bench)
+		*bench = lrng_drng_bench[--lrng_drng_bench_num];
+}
+
+/* Measure seed latency and generate throughput of a DRNG backend */
+static struct lrng_drng_bench *lrng_drng_benchmark(
+					const struct lrng_crypto_cb *cb)
+{
+	struct lrng_drng_bench *bench = lrng_drng_bench_find(cb);
+	u8 seed[LRNG_DRNG_SECURITY_STRENGTH_BYTES] = { 0 };
+	const char *name = cb->lrng_drng_name();
+	u32 processed = 0, reqsize;
+	u64 start, time;
+	void *drng;
+	u8 *buf;
+	int ret = 0;
+
+	if (bench)
+		return bench;
+	if (lrng_drng_bench_num >= LRNG_DRNG_BENCH_MAX)
+		return NULL;
+
+	reqsize = lrng_drng_max_reqsize(cb);
+	buf = kmalloc(reqsize, GFP_KERNEL);
+	if (!buf)
+		return NULL;
+
+	drng = cb->lrng_drng_alloc(LRNG_DRNG_SECURITY_STRENGTH_BYTES,
+				   numa_node_id());
+	if (IS_ERR(drng)) {
+		kfree(buf);
+		return NULL;
+	}
+
+	/* The instance is discarded, no secret seed needed */
+	start = ktime_get_ns();
+	ret = cb->lrng_drng_seed_helper(drng, seed, sizeof(seed));
+	time = ktime_get_ns() - start;
+	if (ret < 0)
+		goto out;
+
+	bench = &lrng_drng_bench[lrng_drng_bench_num++];
+	bench->cb = cb;
+	strscpy(bench->name, name, sizeof(bench->name));
+	bench->seed_ns = time;
+	bench->eligible = !drng_require_sp80090a ||
+			  !strncmp(name, "drbg_", 5);
+
+	start = ktime_get_ns();
+	while (processed < LRNG_DRNG_BENCH_BYTES) {
+		ret = cb->lrng_drng_generate_helper(drng, buf, reqsize);
+		if (ret <= 0)
+			break;
+		processed += ret;
+	}
+	time = ktime_get_ns() - start;
+	bench->generate_mbps = div64_u64((u64)processed * 1000, time ?: 1);
+	if (ret <= 0)
+		bench->eligible = false;
+
+	pr_info("DRNG backend %s: %llu MB/s generate, %llu ns seed%s\n", name,
+		bench->generate_mbps, bench->seed_ns,
+		bench->eligible ? "" : " (not eligible)");
+
+out:
+	cb->lrng_drng_dealloc(drng);
+	kzfree(buf);
+	return bench;
+}
+
+/*
+ * Decide whether the offered backend shall replace the current backend. The
+ * caller must hold the lrng_crypto_cb_update lock.
+ */
+static bool lrng_drng_autoselect(const struct lrng_crypto_cb *cb)
+{
+	struct lrng_drng_bench *new, *cur;
+
+	cur = lrng_drng_benchmark(lrng_pdrng.crypto_cb);
+	new = lrng_drng_benchmark(cb);
+	if (!new || !new->eligible)
+		return false;
+
+	/* The default backend is only kept if it is eligible */
+	if (!cur || !cur->eligible)
+		return true;
+
+	return new->generate_mbps > cur->generate_mbps;
+}
+
 /**
  * lrng_set_drng_cb - Register new cryptographic callback functions for DRNG
  * The registering implies that all old DRNG states are replaced with new
  * DRNG states.
+ *
+ * With drng_autoselect, the new callbacks are only used if they win the
+ * self-benchmark against the current callbacks, otherwise -EBUSY is returned.
+ *
  * @cb: Callback functions to be registered -- if NULL, use the default
  *	callbacks pointing to the ChaCha20 DRNG.
  * @return: 0 on success, < 0 on error
@@ -1753,11 +3819,24 @@ int lrng_set_drng_cb(const struct lrng_crypto_cb *cb)
 {
 	int ret;
 
-	if (!cb)
-		cb = &lrng_cc20_crypto_cb;
-
 	mutex_lock(&lrng_crypto_cb_update);
 
+	/* Deregistration: the module providing the callbacks goes away */
+	if (!cb) {
+		if (lrng_pdrng.crypto_cb != &lrng_cc20_crypto_cb)
+			lrng_drng_bench_remove(lrng_pdrng.crypto_cb);
+		cb = &lrng_cc20_crypto_cb;
+	}
+
+	if (drng_autoselect && cb != &lrng_cc20_crypto_cb) {
+		if (!lrng_drng_autoselect(cb)) {
+			pr_info("DRNG backend %s not selected\n",
+				cb->lrng_drng_name());
+			/* The module providing the callbacks fails to load */
+			lrng_drng_bench_remove(cb);
+			ret = -EBUSY;
+			goto out;
+		}
 	/*
 	 * If a callback other than the default is set, allow it only to be
 	 * set back to the default callback. This ensures that multiple
@@ -1767,8 +3846,8 @@ int lrng_set_drng_cb(const struct lrng_crypto_cb *cb)
 	 * (e.g. the kernel module providing it must be unloaded) and the new
 	 * implementation can be registered.
 	 */
-	if ((cb != &lrng_cc20_crypto_cb) &&
-	    (lrng_pdrng.crypto_cb != &lrng_cc20_crypto_cb)) {
+	} else if ((cb != &lrng_cc20_crypto_cb) &&
+		   (lrng_pdrng.crypto_cb != &lrng_cc20_crypto_cb)) {
 		pr_warn("disallow setting new cipher callbacks, unload the old "
 			"callbacks first!\n");
 		ret = -EINVAL;
@@ -1783,6 +3862,22 @@ out:
 }
 EXPORT_SYMBOL(lrng_set_drng_cb);
 
+/**
+ * lrng_unset_drng_cb - Deregister cryptographic callback functions
+ * The default callbacks are restored only if the given callbacks are in use,
+ * as with drng_autoselect a backend may have been replaced by a faster one.
+ * @cb: Callback functions to be deregistered
+ */
+void lrng_unset_drng_cb(const struct lrng_crypto_cb *cb)
+{
+	mutex_lock(&lrng_crypto_cb_update);
+	if (lrng_pdrng.crypto_cb == cb)
+		lrng_drngs_switch(&lrng_cc20_crypto_cb);
+	lrng_drng_bench_remove(cb);
+	mutex_unlock(&lrng_crypto_cb_update);
+}
+EXPORT_SYMBOL(lrng_unset_drng_cb);
+
 /************************** LRNG kernel interfaces ***************************/
 
 void get_random_bytes(void *buf, int nbytes)
@@ -1876,6 +3971,112 @@ void add_hwgenerator_randomness(const char *buffer, size_t count,
 }
 EXPORT_SYMBOL_GPL(add_hwgenerator_randomness);
 
+/*
+ * Seed handed over by the boot loader, e.g. the EFI LINUX_EFI_RANDOM_SEED
+ * table or the device tree /chosen/rng-seed property. The LRNG cannot assess
+ * how the boot loader obtained the seed -- unless the boot loader is trusted,
+ * no entropy is credited.
+ *
+ * The callers hand the seed to add_bootloader_randomness starting with Linux
+ * 5.4. For older kernels, the kernel_patches integration switches the EFI
+ * caller.
+ */
+#define LRNG_BOOTLOADER_TRUST_STRENGTH LRNG_DRNG_SECURITY_STRENGTH_BITS
+#ifdef CONFIG_RANDOM_TRUST_BOOTLOADER
+static u32 bootloader_seed_credit = LRNG_BOOTLOADER_TRUST_STRENGTH;
+#else
+static u32 bootloader_seed_credit = 0;
+#endif
+module_param(bootloader_seed_credit, uint, 0444);
+MODULE_PARM_DESC(bootloader_seed_credit, "Entropy in bits credited to the seed "
+					 "provided by the boot loader");
+
+static int __init lrng_parse_trust_bootloader(char *arg)
+{
+	int ret;
+	bool trust_bootloader = false;
+
+	ret = kstrtobool(arg, &trust_bootloader);
+	if (ret)
+		return ret;
+
+	bootloader_seed_credit = trust_bootloader ?
+				 LRNG_BOOTLOADER_TRUST_STRENGTH : 0;
+
+	return 0;
+}
+early_param("random.trust_bootloader", lrng_parse_trust_bootloader);
+
+/*
+ * The boot loader seed arrives during setup_arch before the primary DRNG is
+ * available. It is held until lrng_bootloader_seed_inject is invoked by an
+ * early initcall and erased afterwards.
+ */
+#define LRNG_BOOTLOADER_SEED_MAX	(2 * LRNG_DRNG_SECURITY_STRENGTH_BYTES)
+static u8 lrng_bootloader_seed[LRNG_BOOTLOADER_SEED_MAX];
+static u32 lrng_bootloader_seedlen;
+static u32 lrng_bootloader_seed_credit;
+static DEFINE_SPINLOCK(lrng_bootloader_seed_lock);
+
+/**
+ * Handle random seed passed by boot loader.
+ *
+ * The data is mixed into the entropy pool without entropy and injected into
+ * the primary DRNG with the entropy configured with bootloader_seed_credit
+ * (or the random.trust_bootloader kernel command line option).
+ *
+ * @buf: buffer holding the seed
+ * @size: length of buffer
+ */
+void add_bootloader_randomness(const void *buf, unsigned int size)
+{
+	u32 credit = min_t(u32, bootloader_seed_credit, size << 3);
+	unsigned long flags;
+
+	add_device_randomness(buf, size);
+
+	if (atomic_read(&lrng_pdrng_avail) && !irqs_disabled()) {
+		lrng_pdrng_inject(buf, size, credit, NULL, 0, false);
+		return;
+	}
+
+	spin_lock_irqsave(&lrng_bootloader_seed_lock, flags);
+	size = min_t(u32, size,
+		     LRNG_BOOTLOADER_SEED_MAX - lrng_bootloader_seedlen);
+	memcpy(lrng_bootloader_seed + lrng_bootloader_seedlen, buf, size);
+	lrng_bootloader_seedlen += size;
+	lrng_bootloader_seed_credit += min_t(u32, credit, size << 3);
+	spin_unlock_irqrestore(&lrng_bootloader_seed_lock, flags);
+}
+EXPORT_SYMBOL_GPL(add_bootloader_randomness);
+
+/* Inject the held boot loader seed into the primary DRNG and erase it */
+static void __init lrng_bootloader_seed_inject(void)
+{
+	u8 seed[LRNG_BOOTLOADER_SEED_MAX];
+	unsigned long flags;
+	u32 seedlen, credit;
+
+	spin_lock_irqsave(&lrng_bootloader_seed_lock, flags);
+	seedlen = lrng_bootloader_seedlen;
+	credit = lrng_bootloader_seed_credit;
+	memcpy(seed, lrng_bootloader_seed, seedlen);
+	memzero_explicit(lrng_bootloader_seed, sizeof(lrng_bootloader_seed));
+	lrng_bootloader_seedlen = 0;
+	lrng_bootloader_seed_credit = 0;
+	spin_unlock_irqrestore(&lrng_bootloader_seed_lock, flags);
+
+	if (!seedlen)
+		return;
+
+	lrng_drngs_init_cc20();
+	lrng_pdrng_inject(seed, seedlen, credit, NULL, 0, false);
+	memzero_explicit(seed, seedlen);
+
+	pr_info("boot loader seed of %u bytes injected with %u bits of "
+		"entropy\n", seedlen, credit);
+}
+
 /**
  * Delete a previously registered readiness callback function.
  */
@@ -1953,7 +4154,8 @@ static ssize_t lrng_read_common(char __user *buf, size_t nbytes,
 	 * those by using the stack variable of tmpbuf.
 	 */
 	if (nbytes > sizeof(tmpbuf)) {
-		tmplen = min_t(u32, nbytes, LRNG_DRNG_MAX_REQSIZE);
+		tmplen = min_t(u32, nbytes, lrng_drng_max_reqsize(
+					READ_ONCE(lrng_sdrng_init.crypto_cb)));
 		tmp_large = kmalloc(tmplen + LRNG_KCAPI_ALIGN, GFP_KERNEL);
 		if (!tmp_large)
 			tmplen = sizeof(tmpbuf);
@@ -2098,6 +4300,8 @@ static ssize_t lrng_drng_write_common(const char __user *buffer, size_t count,
 				 node);
 		}
 		lrng_sdrng_atomic.force_reseed = true;
+		lrng_group_drngs_force_reseed();
+		lrng_prefetch_invalidate();
 	}
 
 out:
@@ -2124,6 +4328,99 @@ static ssize_t lrng_drng_write(struct file *file, const char __user *buffer,
 	return lrng_drng_write_common(buffer, count, 0);
 }
 
+/*
+ * Seed file handoff: the seed saved during the previous boot is injected into
+ * the primary DRNG and a replacement seed to be saved for the next boot is
+ * returned in the same buffer with one privileged call. The argument has the
+ * layout of struct rand_pool_info used with RNDADDENTROPY: entropy_count
+ * holds the entropy the caller claims for the seed on input and the entropy
+ * credited by the kernel on output, buf_size is the size of the seed.
+ * RNDSEEDFILE is part of <uapi/linux/random.h> with the LRNG kernel patches,
+ * test/seedfile.c exercises the ioctl.
+ */
+#ifndef RNDSEEDFILE
+#define RNDSEEDFILE _IOWR('R', 0x08, int [2])
+#endif
+
+#define LRNG_SEEDFILE_MAX	512
+
+/*
+ * Entropy in bits credited to a seed file at most. The seed file is stored on
+ * disk between boots and only the system policy can decide whether it is
+ * protected well enough to be trusted. Only the first seed file injected after
+ * boot is credited as any later one is a replay of the same seed.
+ */
+static u32 seedfile_credit = 0;
+module_param(seedfile_credit, uint, 0644);
+MODULE_PARM_DESC(seedfile_credit, "Entropy in bits credited to the seed file "
+				  "injected with RNDSEEDFILE");
+
+static atomic_t lrng_seedfile_credited = ATOMIC_INIT(0);
+
+static long lrng_seedfile_handoff(int __user *p)
+{
+	int ent_count_bits, size;
+	u32 credit;
+	u8 *buf;
+	long ret;
+
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+	if (!atomic_read(&lrng_pdrng_avail))
+		return -EAGAIN;
+	if (get_user(ent_count_bits, p) || get_user(size, p + 1))
+		return -EFAULT;
+	if (ent_count_bits < 0 || size <= 0 || size > LRNG_SEEDFILE_MAX)
+		return -EINVAL;
+
+	buf = kmalloc(size, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+	if (copy_from_user(buf, p + 2, size)) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	credit = min3((u32)ent_count_bits, (u32)size << 3,
+		      READ_ONCE(seedfile_credit));
+	if (credit && atomic_xchg(&lrng_seedfile_credited, 1))
+		credit = 0;
+
+	ret = lrng_pdrng_inject(buf, size, credit, NULL, 0, false);
+	if (ret < 0)
+		goto out;
+
+	/* The secondary DRNGs pick up the seed with their next reseed */
+	lrng_drng_write_common(NULL, 0, 0);
+
+	/*
+	 * Draw the replacement seed from the primary DRNG which already holds
+	 * the injected seed file -- a secondary DRNG may still serve its old
+	 * state until its forced reseed executed.
+	 */
+	mutex_lock(&lrng_pdrng.lock);
+	ret = lrng_pdrng.crypto_cb->lrng_drng_generate_helper(lrng_pdrng.pdrng,
+							      buf, size);
+	mutex_unlock(&lrng_pdrng.lock);
+	if (ret != size) {
+		pr_warn("generating replacement seed failed (%ld)\n", ret);
+		ret = -EFAULT;
+		goto out;
+	}
+
+	if (copy_to_user(p + 2, buf, size) || put_user((int)credit, p)) {
+		ret = -EFAULT;
+		goto out;
+	}
+	pr_debug("seed file of %d bytes injected with %u bits of entropy\n",
+		 size, credit);
+	ret = 0;
+
+out:
+	kzfree(buf);
+	return ret;
+}
+
 static long lrng_ioctl(struct file *f, unsigned int cmd, unsigned long arg)
 {
 	int size, ent_count_bits;
@@ -2181,6 +4478,8 @@ static long lrng_ioctl(struct file *f, unsigned int cmd, unsigned long arg)
                         return -EPERM;
 		/* Force a reseed of all secondary DRNGs */
 		return lrng_drng_write_common(NULL, 0, 0);
+	case RNDSEEDFILE:
+		return lrng_seedfile_handoff(p);
 	default:
 		return -EINVAL;
 	}
@@ -2261,6 +4560,51 @@ static int lrng_max_write_thresh = LRNG_POOL_SIZE_BITS;
 static char lrng_sysctl_bootid[16];
 static int lrng_sdrng_reseed_max_min;
 
+/* drng_<tier>_reseed_bytes and drng_<tier>_reseed_secs of one DRNG tier */
+#define LRNG_SYSCTL_RESEED_TIER(name, tier)				\
+	{								\
+		.procname	= "drng_" name "_reseed_bytes",		\
+		.data		= &lrng_sdrng_reseed_bytes[tier],	\
+		.maxlen		= sizeof(unsigned long),		\
+		.mode		= 0644,					\
+		.proc_handler	= proc_doulongvec_minmax,		\
+	},								\
+	{								\
+		.procname	= "drng_" name "_reseed_secs",		\
+		.data		= &lrng_sdrng_reseed_secs[tier],	\
+		.maxlen		= sizeof(int),				\
+		.mode		= 0644,					\
+		.proc_handler	= proc_dointvec_minmax,			\
+		.extra1		= &lrng_sdrng_reseed_max_min,		\
+	}
+
+/*
+ * Legacy reseed interval covering all DRNG tiers: reading returns the value of
+ * the node tier, writing sets all tiers.
+ */
+static int lrng_proc_do_reseed_secs(struct ctl_table *table, int write,
+				    void __user *buffer, size_t *lenp,
+				    loff_t *ppos)
+{
+	struct ctl_table fake_table;
+	int secs = READ_ONCE(lrng_sdrng_reseed_secs[LRNG_SDRNG_TIER_NODE]);
+	int ret, i;
+
+	fake_table.data = &secs;
+	fake_table.maxlen = sizeof(secs);
+	fake_table.extra1 = &lrng_sdrng_reseed_max_min;
+	fake_table.extra2 = NULL;
+
+	ret = proc_dointvec_minmax(&fake_table, write, buffer, lenp, ppos);
+	if (ret || !write)
+		return ret;
+
+	for (i = 0; i < LRNG_SDRNG_TIER_MAX; i++)
+		WRITE_ONCE(lrng_sdrng_reseed_secs[i], secs);
+
+	return 0;
+}
+
 /*
  * This function is used to return both the bootid UUID, and random
  * UUID.  The difference is in whether table->data is NULL; if it is,
@@ -2300,29 +4644,136 @@ static int lrng_proc_do_uuid(struct ctl_table *table, int write,
 static int lrng_proc_do_type(struct ctl_table *table, int write,
 			     void __user *buffer, size_t *lenp, loff_t *ppos)
 {
+	struct lrng_arch_stat arch = { 0 };
+	const struct lrng_drng_caps *caps;
 	struct ctl_table fake_table;
 	unsigned long flags = 0;
-	unsigned char buf[200];
+	unsigned char *buf;
+	size_t len;
+	int ret, cpu;
+	u32 i;
 
+	buf = kzalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	mutex_lock(&lrng_crypto_cb_update);
 	mutex_lock(&lrng_pdrng.lock);
 	lrng_sdrng_lock(&lrng_sdrng_init, &flags);
-	snprintf(buf, sizeof(buf),
+	len = scnprintf(buf, PAGE_SIZE,
 		 "primary DRNG name: %s\n"
 		 "secondary DRNG name: %s\n"
 		 "Hash for reading entropy pool: %s\n"
 		 "DRNG security strength: %d bits\n"
-		 "number of secondary DRNG instances: %u",
+		 "number of secondary DRNG instances: %u\n"
+		 "seeds from primary DRNG: %lld\n"
+		 "seeds from secondary DRNGs: %lld",
 		 lrng_pdrng.crypto_cb->lrng_drng_name(),
 		 lrng_sdrng_init.crypto_cb->lrng_drng_name(),
 		 lrng_pdrng.crypto_cb->lrng_hash_name(),
-		 LRNG_DRNG_SECURITY_STRENGTH_BITS, lrng_pool.numa_drngs);
+		 LRNG_DRNG_SECURITY_STRENGTH_BITS, lrng_pool.numa_drngs,
+		 (long long)atomic64_read(
+			&lrng_seed_level_seeds[LRNG_SEED_LEVEL_PRIMARY]),
+		 (long long)atomic64_read(
+			&lrng_seed_level_seeds[LRNG_SEED_LEVEL_NODE]));
 	lrng_sdrng_unlock(&lrng_sdrng_init, &flags);
 	mutex_unlock(&lrng_pdrng.lock);
 
+	for_each_possible_cpu(cpu) {
+		struct lrng_arch_stat *stat = per_cpu_ptr(&lrng_arch_stat, cpu);
+
+		arch.seed += stat->seed;
+		arch.seed_retries += stat->seed_retries;
+		arch.rand += stat->rand;
+		arch.failures += stat->failures;
+		arch.prefetched += stat->prefetched;
+	}
+	len += scnprintf(buf + len, PAGE_SIZE - len,
+			 "\nCPU noise source words: %lu (retries %lu), "
+			 "fallback words: %lu, failed blocks: %lu, prefetched "
+			 "blocks: %lu",
+			 arch.seed, arch.seed_retries, arch.rand,
+			 arch.failures, arch.prefetched);
+
+#ifdef CONFIG_BLOCK
+	len += scnprintf(buf + len, PAGE_SIZE - len,
+			 "\nblock device time stamps: %lld, credited as "
+			 "interrupts: %lld",
+			 (long long)atomic64_read(&lrng_disk_stat.samples),
+			 (long long)atomic64_read(&lrng_disk_stat.events));
+#endif
+#ifdef CONFIG_TRACEPOINTS
+	if (sched_noise)
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				 "\ncontext switch time stamps: %lld, credited "
+				 "as interrupts: %lld",
+				 (long long)atomic64_read(
+					&lrng_sched_stat.samples),
+				 (long long)atomic64_read(
+					&lrng_sched_stat.events));
+#endif
+
+	caps = lrng_drng_caps(lrng_sdrng_init.crypto_cb);
+	len += scnprintf(buf + len, PAGE_SIZE - len,
+			 "\nsecondary DRNG capabilities: version %u, chunk %u "
+			 "bytes, max request %u bytes%s%s%s",
+			 caps->version, caps->chunk_size,
+			 lrng_drng_max_reqsize(lrng_sdrng_init.crypto_cb),
+			 (caps->flags & LRNG_DRNG_CAP_PARALLEL) ?
+							", parallel" : "",
+			 (caps->flags & LRNG_DRNG_CAP_FPU) ? ", FPU" : "",
+			 (caps->flags & LRNG_DRNG_CAP_SEED_EXPENSIVE) ?
+							", expensive seed" : "");
+
+	for (i = 0; i < lrng_drng_bench_num; i++) {
+		struct lrng_drng_bench *bench = &lrng_drng_bench[i];
+
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				 "\nbenchmark %s: %llu MB/s, seed %llu ns%s",
+				 bench->name, bench->generate_mbps,
+				 bench->seed_ns,
+				 bench->eligible ? "" : " (not eligible)");
+	}
+	mutex_unlock(&lrng_crypto_cb_update);
+
 	fake_table.data = buf;
-	fake_table.maxlen = sizeof(buf);
+	fake_table.maxlen = PAGE_SIZE;
 
-	return proc_dostring(&fake_table, write, buffer, lenp, ppos);
+	ret = proc_dostring(&fake_table, write, buffer, lenp, ppos);
+	kfree(buf);
+	return ret;
+}
+
+/* Throughput of the per-group DRNGs: group identifier, requests, bytes */
+static int lrng_proc_do_group_drngs(struct ctl_table *table, int write,
+				    void __user *buffer, size_t *lenp,
+				    loff_t *ppos)
+{
+	struct ctl_table fake_table;
+	struct lrng_group_drng *grp;
+	unsigned char *buf;
+	size_t len = 0;
+	int bkt, ret;
+
+	buf = kzalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	rcu_read_lock();
+	hash_for_each_rcu(lrng_group_drngs, bkt, grp, list) {
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				 "%llu %lld %lld\n", grp->id,
+				 (long long)atomic64_read(&grp->requests),
+				 (long long)atomic64_read(&grp->bytes));
+	}
+	rcu_read_unlock();
+
+	fake_table.data = buf;
+	fake_table.maxlen = PAGE_SIZE;
+
+	ret = proc_dostring(&fake_table, write, buffer, lenp, ppos);
+	kfree(buf);
+	return ret;
 }
 
 /* Return entropy available scaled to integral bits */
@@ -2406,12 +4857,13 @@ struct ctl_table random_table[] = {
 	},
 	{
 		.procname       = "urandom_min_reseed_secs",
-		.data           = &lrng_sdrng_reseed_max_time,
 		.maxlen         = sizeof(int),
 		.mode           = 0644,
-		.proc_handler   = proc_dointvec,
-		.extra1		= &lrng_sdrng_reseed_max_min,
+		.proc_handler   = lrng_proc_do_reseed_secs,
 	},
+	LRNG_SYSCTL_RESEED_TIER("init", LRNG_SDRNG_TIER_INIT),
+	LRNG_SYSCTL_RESEED_TIER("node", LRNG_SDRNG_TIER_NODE),
+	LRNG_SYSCTL_RESEED_TIER("atomic", LRNG_SDRNG_TIER_ATOMIC),
 	{
 		.procname	= "drng_fully_seeded",
 		.data		= &lrng_pdrng.pdrng_fully_seeded,
@@ -2432,6 +4884,11 @@ struct ctl_table random_table[] = {
 		.mode		= 0444,
 		.proc_handler	= lrng_proc_do_type,
 	},
+	{
+		.procname	= "group_drngs",
+		.mode		= 0444,
+		.proc_handler	= lrng_proc_do_group_drngs,
+	},
 	{
 		.procname	= "drng_security_strength",
 		.data		= &pdrng_security_strength,
@@ -2439,6 +4896,13 @@ struct ctl_table random_table[] = {
 		.mode		= 0444,
 		.proc_handler	= proc_dointvec,
 	},
+	{
+		.procname	= "seed_latency_max_usecs",
+		.data		= &lrng_seed_latency_max_us,
+		.maxlen		= sizeof(unsigned long),
+		.mode		= 0444,
+		.proc_handler	= proc_doulongvec_minmax,
+	},
 	{
 		.procname	= "high_resolution_timer",
 		.data		= &lrng_pool.irq_info.irq_highres_timer,
@@ -2587,11 +5051,26 @@ randomize_page(unsigned long start, unsigned long range)
 static int __init lrng_init(void)
 {
 	lrng_drngs_numa_alloc();
+	lrng_drngs_numa_hotplug_init();
+	lrng_prefetch_init();
+	/* Boot loader seed handed over after the early initcalls */
+	lrng_bootloader_seed_inject();
 	return 0;
 }
 
 late_initcall(lrng_init);
 
+/* Make the boot loader seed available before the first initcall users */
+static int __init lrng_early_init(void)
+{
+	lrng_bootloader_seed_inject();
+	lrng_sched_noise_init();
+	lrng_jent_harvest_init();
+	return 0;
+}
+
+early_initcall(lrng_early_init);
+
 MODULE_LICENSE("Dual BSD/GPL");
 MODULE_AUTHOR("Stephan Mueller <smueller@chronox.de>");
 MODULE_DESCRIPTION("Linux Random Number Generator");
@@ -22,9 +22,14 @@
 #define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
 
 #include <crypto/chacha.h>
+#ifdef CONFIG_LRNG_CC20_BLAKE2S
+#include <crypto/blake2s.h>
+#else
 #include <linux/cryptohash.h>
+#endif
 #include <linux/lrng.h>
 #include <linux/random.h>
+#include <linux/slab.h>
 
 /******************************* ChaCha20 DRNG *******************************/
 
@@ -239,9 +244,9 @@ void lrng_cc20_init_state(struct chacha20_state *state)
 }
 
 /**
- * Allocation of the DRNG state
+ * Allocation of the DRNG state on the NUMA node it is used on
  */
-static void *lrng_cc20_drng_alloc(u32 sec_strength)
+static void *lrng_cc20_drng_alloc(u32 sec_strength, int node)
 {
 	struct chacha20_state *state = NULL;
 
@@ -256,7 +261,7 @@ static void *lrng_cc20_drng_alloc(u32 sec_strength)
 			"than requested by LRNG (%u bits)\n",
 			CHACHA_KEY_SIZE * 8, sec_strength * 8);
 
-	state = kmalloc(sizeof(struct chacha20_state), GFP_KERNEL);
+	state = kmalloc_node(sizeof(struct chacha20_state), GFP_KERNEL, node);
 	if (!state)
 		return ERR_PTR(-ENOMEM);
 	pr_debug("memory for ChaCha20 core allocated\n");
@@ -282,6 +287,82 @@ static void lrng_cc20_drng_dealloc(void *drng)
 
 /******************************* Hash Operation *******************************/
 
+#ifdef CONFIG_LRNG_CC20_BLAKE2S
+
+/*
+ * BLAKE2s-256 conditioning: one pass over the entropy pool delivers the full
+ * 256 bits required by the DRNG. A hash handle allocated with a key turns the
+ * hash into a keyed BLAKE2s; the handle is NULL for the hash used during
+ * early boot in which case the unkeyed BLAKE2s is applied. Keys longer than
+ * BLAKE2S_KEY_SIZE are hashed to that size as done by HMAC.
+ *
+ * The BLAKE2s library is part of Linux 5.5 and later which also selects the
+ * SIMD compression function of the architecture. For older kernels, the
+ * LRNG kernel patches carry the generic implementation of the library.
+ */
+struct lrng_cc20_hash {
+	u8 key[BLAKE2S_KEY_SIZE];
+	u32 keylen;
+};
+
+static void *lrng_cc20_hash_alloc(const u8 *key, u32 keylen)
+{
+	struct lrng_cc20_hash *hash;
+
+	hash = kmalloc(sizeof(*hash), GFP_KERNEL);
+	if (!hash)
+		return ERR_PTR(-ENOMEM);
+
+	if (keylen > BLAKE2S_KEY_SIZE) {
+		struct blake2s_state state;
+
+		blake2s_init(&state, BLAKE2S_KEY_SIZE);
+		blake2s_update(&state, key, keylen);
+		blake2s_final(&state, hash->key);
+		hash->keylen = BLAKE2S_KEY_SIZE;
+	} else {
+		memcpy(hash->key, key, keylen);
+		hash->keylen = keylen;
+	}
+
+	pr_info("Hash BLAKE2s allocated\n");
+	return hash;
+}
+
+static void lrng_cc20_hash_dealloc(void *hash)
+{
+	kzfree(hash);
+}
+
+static u32 lrng_cc20_hash_digestsize(void *hash)
+{
+	return BLAKE2S_HASH_SIZE;
+}
+
+static int lrng_cc20_hash_buffer(void *hash, const u8 *inbuf, u32 inbuflen,
+				 u8 *digest)
+{
+	struct lrng_cc20_hash *h = (struct lrng_cc20_hash *)hash;
+	struct blake2s_state state;
+
+	if (h && h->keylen)
+		blake2s_init_key(&state, BLAKE2S_HASH_SIZE, h->key, h->keylen);
+	else
+		blake2s_init(&state, BLAKE2S_HASH_SIZE);
+	blake2s_update(&state, inbuf, inbuflen);
+	blake2s_final(&state, digest);
+
+	return 0;
+}
+
+static const char *lrng_cc20_hash_name(void)
+{
+	const char *cc20_hash_name = "BLAKE2s";
+	return cc20_hash_name;
+}
+
+#else /* CONFIG_LRNG_CC20_BLAKE2S */
+
 static void *lrng_cc20_hash_alloc(const u8 *key, u32 keylen)
 {
 	pr_info("Hash SHA-1 allocated\n");
@@ -312,17 +393,25 @@ static int lrng_cc20_hash_buffer(void *hash, const u8 *inbuf, u32 inbuflen,
 	return 0;
 }
 
+static const char *lrng_cc20_hash_name(void)
+{
+	const char *cc20_hash_name = "SHA-1";
+	return cc20_hash_name;
+}
+
+#endif /* CONFIG_LRNG_CC20_BLAKE2S */
+
 static const char *lrng_cc20_drng_name(void)
 {
 	const char *cc20_drng_name = "ChaCha20 DRNG";
 	return cc20_drng_name;
 }
 
-static const char *lrng_cc20_hash_name(void)
-{
-	const char *cc20_hash_name = "SHA-1";
-	return cc20_hash_name;
-}
+static const struct lrng_drng_caps lrng_cc20_caps = {
+	.version	= LRNG_DRNG_CAPS_VERSION,
+	.chunk_size	= CHACHA_BLOCK_SIZE,
+	.flags		= LRNG_DRNG_CAP_PARALLEL,
+};
 
 const struct lrng_crypto_cb lrng_cc20_crypto_cb = {
 	.lrng_drng_name			= lrng_cc20_drng_name,
@@ -332,6 +421,7 @@ const struct lrng_crypto_cb lrng_cc20_crypto_cb = {
 	.lrng_drng_seed_helper		= lrng_cc20_drng_seed_helper,
 	.lrng_drng_generate_helper	= lrng_cc20_drng_generate_helper,
 	.lrng_drng_generate_helper_full	= lrng_cc20_drng_generate_helper_full,
+	.lrng_drng_caps			= &lrng_cc20_caps,
 	.lrng_hash_alloc		= lrng_cc20_hash_alloc,
 	.lrng_hash_dealloc		= lrng_cc20_hash_dealloc,
 	.lrng_hash_digestsize		= lrng_cc20_hash_digestsize,
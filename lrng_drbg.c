@@ -22,9 +22,12 @@
 #define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
 
 #include <crypto/drbg.h>
+#include <crypto/hash.h>
+#include <crypto/sha.h>
 #include <linux/init.h>
 #include <linux/module.h>
 #include <linux/lrng.h>
+#include <linux/scatterlist.h>
 
 /*
  * Define a DRBG plus a hash / MAC used to extract data from the entropy pool.
@@ -56,21 +59,37 @@ module_param(lrng_drbg_type, uint, 0444);
 MODULE_PARM_DESC(lrng_drbg_type, "DRBG type used for LRNG (0->CTR_DRBG, "
 				 "1->HMAC_DRBG, 2->Hash_DRBG)");
 
+/*
+ * Bulk generation: request up to the SP800-90A maximum of 1<<16 bytes per
+ * DRBG generate operation instead of the LRNG default of 4096 bytes. The
+ * DRBG update operation concluding each generate request is thus amortized
+ * over 16 times the amount of data and the CTR_DRBG core encrypts the output
+ * with ctr(aes) in large multi-block batches.
+ */
+static bool lrng_drbg_bulk = true;
+module_param(lrng_drbg_bulk, bool, 0444);
+MODULE_PARM_DESC(lrng_drbg_bulk, "Generate up to the SP800-90A maximum request "
+				 "size per DRBG generate operation");
+
 struct lrng_drbg {
 	const char *hash_name;
 	const char *drbg_core;
+	u32 blocklen;
 };
 
 static const struct lrng_drbg lrng_drbg_types[] = {
 	{	/* CTR_DRBG with AES-256 using derivation function */
 		.hash_name = "cmac(aes)",
 		.drbg_core = "drbg_nopr_ctr_aes256",
+		.blocklen = 16,
 	}, {	/* HMAC_DRBG with SHA-512 */
 		.hash_name = "sha512",
 		.drbg_core = "drbg_nopr_hmac_sha512",
+		.blocklen = 64,
 	}, {	/* Hash_DRBG with SHA-512 using derivation function */
 		.hash_name = "sha512",
-		.drbg_core = "drbg_nopr_sha512"
+		.drbg_core = "drbg_nopr_sha512",
+		.blocklen = 64,
 	}
 };
 
@@ -79,9 +98,19 @@ struct lrng_hash_info {
 	char ctx[];
 };
 
+struct lrng_drbg_lane;
+
+/* DRBG state handle with the preallocated Hashgen lanes, if any */
+struct lrng_drbg_state {
+	struct drbg_state drbg;
+	struct lrng_drbg_lane *lanes;
+	u32 nlanes;
+};
+
 static int lrng_drbg_drng_seed_helper(void *drng, const u8 *inbuf, u32 inbuflen)
 {
-	struct drbg_state *drbg = (struct drbg_state *)drng;
+	struct lrng_drbg_state *state = (struct lrng_drbg_state *)drng;
+	struct drbg_state *drbg = &state->drbg;
 	LIST_HEAD(seedlist);
 	struct drbg_string data;
 	int ret;
@@ -96,15 +125,214 @@ static int lrng_drbg_drng_seed_helper(void *drng, const u8 *inbuf, u32 inbuflen)
 	return ret;
 }
 
+/*
+ * Hash_DRBG generate operation with the Hashgen output blocks computed in
+ * parallel lanes. The Hashgen blocks Hash(V + i) are independent of each other
+ * and thus are submitted as a batch of asynchronous hash requests. With a
+ * multi-buffer or otherwise asynchronous SHA-512 implementation registered
+ * with the kernel crypto API, the blocks of a batch are processed in parallel.
+ * Without such an implementation, the lanes only add overhead. Thus, the
+ * DRBG core is used by default.
+ *
+ * The lanes are only used if the generated data is identical to the data
+ * generated by the DRBG core which is verified with a known-answer test when
+ * loading the module. The hash requests are preallocated per DRBG instance.
+ */
+static unsigned int lrng_drbg_hash_lanes = 1;
+module_param(lrng_drbg_hash_lanes, uint, 0444);
+MODULE_PARM_DESC(lrng_drbg_hash_lanes, "Number of Hashgen blocks of the "
+				       "Hash_DRBG computed in parallel "
+				       "(0 or 1 = use DRBG core, maximum 16)");
+
+#define LRNG_DRBG_HASH_LANES_MAX	16
+/* Seed length of Hash_DRBG with SHA-512 (SP800-90A table 2) */
+#define LRNG_DRBG_HASH_STATELEN		111
+
+struct lrng_drbg_lane {
+	struct ahash_request *req;
+	struct crypto_wait wait;
+	struct scatterlist sg;
+	u8 data[LRNG_DRBG_HASH_STATELEN];
+	u8 digest[SHA512_DIGEST_SIZE];
+	int ret;
+};
+
+static struct crypto_ahash *lrng_drbg_hash_tfm = NULL;
+
+/* Big-endian addition of add to dst as defined for the Hash_DRBG */
+static void lrng_drbg_add_buf(u8 *dst, size_t dstlen, const u8 *add,
+			      size_t addlen)
+{
+	u8 *dstptr = dst + dstlen - 1;
+	const u8 *addptr = add + addlen - 1;
+	unsigned int remainder = 0;
+	size_t len = addlen;
+
+	while (len) {
+		remainder += *dstptr + *addptr;
+		*dstptr = remainder & 0xff;
+		remainder >>= 8;
+		len--; dstptr--; addptr--;
+	}
+	len = dstlen - addlen;
+	while (len && remainder > 0) {
+		remainder = *dstptr + 1;
+		*dstptr = remainder & 0xff;
+		remainder >>= 8;
+		len--; dstptr--;
+	}
+}
+
+static void lrng_drbg_lane_digest(struct lrng_drbg_lane *lane, u32 len)
+{
+	sg_init_one(&lane->sg, lane->data, len);
+	crypto_init_wait(&lane->wait);
+	ahash_request_set_callback(lane->req, CRYPTO_TFM_REQ_MAY_BACKLOG |
+					      CRYPTO_TFM_REQ_MAY_SLEEP,
+				   crypto_req_done, &lane->wait);
+	ahash_request_set_crypt(lane->req, &lane->sg, lane->digest, len);
+	lane->ret = crypto_ahash_digest(lane->req);
+}
+
+/* SP800-90A section 10.1.1.4 without additional input */
+static int lrng_drbg_hash_generate(struct lrng_drbg_state *state, u8 *outbuf,
+				   u32 outbuflen)
+{
+	struct drbg_state *drbg = &state->drbg;
+	struct lrng_drbg_lane *lanes = state->lanes;
+	u32 statelen = drbg_statelen(drbg), blocklen = drbg_blocklen(drbg);
+	u32 nlanes = state->nlanes;
+	u32 i, processed = 0;
+	u8 data[LRNG_DRBG_HASH_STATELEN];
+	const u8 one = 1, prefix = 0x03;
+	struct scatterlist sg[2];
+	__be64 reseed_ctr;
+	int ret = 0;
+
+	if (statelen != LRNG_DRBG_HASH_STATELEN ||
+	    blocklen != SHA512_DIGEST_SIZE)
+		return -EFAULT;
+
+	/* Step 3: Hashgen -- data = V, w_i = Hash(data), data = data + 1 */
+	memcpy(data, drbg->V, statelen);
+	while (processed < outbuflen) {
+		u32 batch = min_t(u32, nlanes,
+				  DIV_ROUND_UP(outbuflen - processed, blocklen));
+
+		for (i = 0; i < batch; i++) {
+			memcpy(lanes[i].data, data, statelen);
+			lrng_drbg_add_buf(data, statelen, &one, 1);
+			lrng_drbg_lane_digest(&lanes[i], statelen);
+		}
+
+		for (i = 0; i < batch; i++) {
+			u32 todo = min_t(u32, outbuflen - processed, blocklen);
+			int err = crypto_wait_req(lanes[i].ret,
+						  &lanes[i].wait);
+
+			/* Collect all submitted requests before bailing out */
+			if (err)
+				ret = err;
+			if (ret)
+				continue;
+			memcpy(outbuf + processed, lanes[i].digest, todo);
+			processed += todo;
+		}
+		if (ret)
+			goto out;
+	}
+
+	/* Step 4: H = Hash(0x03 || V) */
+	sg_init_table(sg, 2);
+	sg_set_buf(&sg[0], &prefix, 1);
+	sg_set_buf(&sg[1], drbg->V, statelen);
+	crypto_init_wait(&lanes[0].wait);
+	ahash_request_set_callback(lanes[0].req, CRYPTO_TFM_REQ_MAY_BACKLOG |
+						 CRYPTO_TFM_REQ_MAY_SLEEP,
+				   crypto_req_done, &lanes[0].wait);
+	ahash_request_set_crypt(lanes[0].req, sg, lanes[0].digest,
+				statelen + 1);
+	ret = crypto_wait_req(crypto_ahash_digest(lanes[0].req),
+			      &lanes[0].wait);
+	if (ret)
+		goto out;
+
+	/* Step 5: V = (V + H + C + reseed_counter) mod 2^seedlen */
+	lrng_drbg_add_buf(drbg->V, statelen, lanes[0].digest, blocklen);
+	lrng_drbg_add_buf(drbg->V, statelen, drbg->C, statelen);
+	reseed_ctr = cpu_to_be64(drbg->reseed_ctr);
+	lrng_drbg_add_buf(drbg->V, statelen, (u8 *)&reseed_ctr,
+			  sizeof(reseed_ctr));
+
+	ret = outbuflen;
+
+out:
+	memzero_explicit(data, sizeof(data));
+	for (i = 0; i < nlanes; i++) {
+		memzero_explicit(lanes[i].data, sizeof(lanes[i].data));
+		memzero_explicit(lanes[i].digest, sizeof(lanes[i].digest));
+	}
+	return ret;
+}
+
+static void lrng_drbg_lanes_free(struct lrng_drbg_state *state)
+{
+	u32 i;
+
+	if (!state->lanes)
+		return;
+
+	for (i = 0; i < state->nlanes; i++)
+		ahash_request_free(state->lanes[i].req);
+	kzfree(state->lanes);
+	state->lanes = NULL;
+	state->nlanes = 0;
+}
+
+static int lrng_drbg_lanes_alloc(struct lrng_drbg_state *state, int node)
+{
+	u32 nlanes = min_t(u32, lrng_drbg_hash_lanes,
+			   LRNG_DRBG_HASH_LANES_MAX);
+	u32 i;
+
+	state->lanes = kcalloc_node(nlanes, sizeof(*state->lanes), GFP_KERNEL,
+				    node);
+	if (!state->lanes)
+		return -ENOMEM;
+	state->nlanes = nlanes;
+
+	for (i = 0; i < nlanes; i++) {
+		state->lanes[i].req = ahash_request_alloc(lrng_drbg_hash_tfm,
+							  GFP_KERNEL);
+		if (!state->lanes[i].req) {
+			lrng_drbg_lanes_free(state);
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
 static int lrng_drbg_drng_generate_helper(void *drng, u8 *outbuf, u32 outbuflen)
 {
-	struct drbg_state *drbg = (struct drbg_state *)drng;
+	struct lrng_drbg_state *state = (struct lrng_drbg_state *)drng;
+	struct drbg_state *drbg = &state->drbg;
+
+	if (state->lanes)
+		return lrng_drbg_hash_generate(state, outbuf, outbuflen);
 
 	return drbg->d_ops->generate(drbg, outbuf, outbuflen, NULL);
 }
 
-static void *lrng_drbg_drng_alloc(u32 sec_strength)
+/*
+ * The DRBG state handle is allocated on the requested NUMA node. The memory
+ * allocated by drbg_alloc_state (V, C, scratchpad and the cipher handles) is
+ * placed by the default memory policy on the node the LRNG executes the
+ * allocation on.
+ */
+static void *lrng_drbg_drng_alloc(u32 sec_strength, int node)
 {
+	struct lrng_drbg_state *state;
 	struct drbg_state *drbg;
 	int coreref = -1;
 	bool pr = false;
@@ -115,9 +343,10 @@ static void *lrng_drbg_drng_alloc(u32 sec_strength)
 	if (coreref < 0)
 		return ERR_PTR(-EFAULT);
 
-	drbg = kzalloc(sizeof(struct drbg_state), GFP_KERNEL);
-	if (!drbg)
+	state = kzalloc_node(sizeof(struct lrng_drbg_state), GFP_KERNEL, node);
+	if (!state)
 		return ERR_PTR(-ENOMEM);
+	drbg = &state->drbg;
 
 	drbg->core = &drbg_cores[coreref];
 	drbg->seeded = false;
@@ -139,28 +368,103 @@ static void *lrng_drbg_drng_alloc(u32 sec_strength)
 			drbg_sec_strength(drbg->core->flags) * 8,
 			sec_strength * 8);
 
+	if (lrng_drbg_hash_tfm && lrng_drbg_lanes_alloc(state, node))
+		pr_warn("could not allocate Hashgen lanes, using DRBG core\n");
+
 	pr_info("DRBG with %s core allocated\n", drbg->core->backend_cra_name);
 
-	return drbg;
+	return state;
 
 dealloc:
 	if (drbg->d_ops)
 		drbg->d_ops->crypto_fini(drbg);
 	drbg_dealloc_state(drbg);
 err:
-	kfree(drbg);
+	kfree(state);
 	return ERR_PTR(-EINVAL);
 }
 
 static void lrng_drbg_drng_dealloc(void *drng)
 {
-	struct drbg_state *drbg = (struct drbg_state *)drng;
+	struct lrng_drbg_state *state = (struct lrng_drbg_state *)drng;
 
-	drbg_dealloc_state(drbg);
-	kzfree(drbg);
+	lrng_drbg_lanes_free(state);
+	drbg_dealloc_state(&state->drbg);
+	kzfree(state);
 	pr_info("DRBG deallocated\n");
 }
 
+/*
+ * Known-answer test of the Hashgen lanes: two instances seeded identically
+ * must generate the same data with the lanes and with the DRBG core. The
+ * generate operation is repeated to cover the update of V. The request size
+ * spans more than one batch of lanes.
+ */
+#define LRNG_DRBG_KAT_LEN	\
+	(LRNG_DRBG_HASH_LANES_MAX * SHA512_DIGEST_SIZE + 17)
+#define LRNG_DRBG_KAT_STRENGTH	32
+
+static int lrng_drbg_hash_lanes_kat(void)
+{
+	static const u8 seed[LRNG_DRBG_KAT_STRENGTH] = {
+		0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+		0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+		0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+		0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f,
+	};
+	struct lrng_drbg_state *lanes = NULL, *core = NULL;
+	u8 *buf_lanes = NULL, *buf_core = NULL;
+	int i, ret;
+
+	lanes = lrng_drbg_drng_alloc(LRNG_DRBG_KAT_STRENGTH, NUMA_NO_NODE);
+	if (IS_ERR(lanes))
+		return PTR_ERR(lanes);
+	core = lrng_drbg_drng_alloc(LRNG_DRBG_KAT_STRENGTH, NUMA_NO_NODE);
+	if (IS_ERR(core)) {
+		ret = PTR_ERR(core);
+		core = NULL;
+		goto out;
+	}
+
+	buf_lanes = kmalloc(LRNG_DRBG_KAT_LEN, GFP_KERNEL);
+	buf_core = kmalloc(LRNG_DRBG_KAT_LEN, GFP_KERNEL);
+	if (!buf_lanes || !buf_core || !lanes->lanes) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ret = lrng_drbg_drng_seed_helper(lanes, seed, sizeof(seed));
+	if (ret < 0)
+		goto out;
+	ret = lrng_drbg_drng_seed_helper(core, seed, sizeof(seed));
+	if (ret < 0)
+		goto out;
+
+	for (i = 0; i < 2; i++) {
+		ret = lrng_drbg_hash_generate(lanes, buf_lanes,
+					      LRNG_DRBG_KAT_LEN);
+		if (ret < 0)
+			goto out;
+		ret = core->drbg.d_ops->generate(&core->drbg, buf_core,
+						 LRNG_DRBG_KAT_LEN, NULL);
+		if (ret < 0)
+			goto out;
+		if (memcmp(buf_lanes, buf_core, LRNG_DRBG_KAT_LEN)) {
+			ret = -EFAULT;
+			goto out;
+		}
+	}
+	ret = 0;
+
+out:
+	kfree(buf_lanes);
+	kfree(buf_core);
+	if (core)
+		lrng_drbg_drng_dealloc(core);
+	lrng_drbg_drng_dealloc(lanes);
+	return ret;
+}
+
 static void *lrng_drbg_hash_alloc(const u8 *key, u32 keylen)
 {
 	struct lrng_hash_info *lrng_hash;
@@ -237,6 +541,15 @@ static const char *lrng_hash_name(void)
 	return lrng_drbg_types[lrng_drbg_type].hash_name;
 }
 
+/*
+ * Filled in at init time from the selected DRBG type. Every DRBG reseed
+ * operation runs the derivation function or the HMAC update over the seed.
+ */
+static struct lrng_drng_caps lrng_drbg_caps = {
+	.version	= LRNG_DRNG_CAPS_VERSION,
+	.flags		= LRNG_DRNG_CAP_PARALLEL | LRNG_DRNG_CAP_SEED_EXPENSIVE,
+};
+
 const static struct lrng_crypto_cb lrng_drbg_crypto_cb = {
 	.lrng_drng_name			= lrng_drbg_name,
 	.lrng_hash_name			= lrng_hash_name,
@@ -245,6 +558,7 @@ const static struct lrng_crypto_cb lrng_drbg_crypto_cb = {
 	.lrng_drng_seed_helper		= lrng_drbg_drng_seed_helper,
 	.lrng_drng_generate_helper	= lrng_drbg_drng_generate_helper,
 	.lrng_drng_generate_helper_full	= lrng_drbg_drng_generate_helper,
+	.lrng_drng_caps			= &lrng_drbg_caps,
 	.lrng_hash_alloc		= lrng_drbg_hash_alloc,
 	.lrng_hash_dealloc		= lrng_drbg_hash_dealloc,
 	.lrng_hash_digestsize		= lrng_drbg_hash_digestsize,
@@ -253,18 +567,60 @@ const static struct lrng_crypto_cb lrng_drbg_crypto_cb = {
 
 static int __init lrng_drbg_init(void)
 {
+	int ret;
+
 	if (lrng_drbg_type >= ARRAY_SIZE(lrng_drbg_types)) {
 		pr_err("lrng_drbg_type parameter too large (given %u - max: %lu)",
 		       lrng_drbg_type,
 		       (unsigned long)ARRAY_SIZE(lrng_drbg_types) - 1);
 		return -EAGAIN;
 	}
-	return lrng_set_drng_cb(&lrng_drbg_crypto_cb);
+
+	lrng_drbg_caps.chunk_size = lrng_drbg_types[lrng_drbg_type].blocklen;
+	/* Identical for all DRBG types, see drbg_max_request_bytes */
+	lrng_drbg_caps.max_reqsize = lrng_drbg_bulk ? (1 << 16) : 0;
+
+	/* Hash_DRBG with parallel Hashgen lanes */
+	if (lrng_drbg_type == 2 && lrng_drbg_hash_lanes > 1) {
+		struct crypto_ahash *tfm = crypto_alloc_ahash(
+				lrng_drbg_types[lrng_drbg_type].hash_name, 0, 0);
+
+		if (IS_ERR(tfm)) {
+			pr_warn("could not allocate hash for Hashgen lanes, "
+				"using DRBG core\n");
+		} else {
+			lrng_drbg_hash_tfm = tfm;
+			ret = lrng_drbg_hash_lanes_kat();
+			if (ret) {
+				pr_warn("Hashgen lanes self test failed (%d), "
+					"using DRBG core\n", ret);
+				crypto_free_ahash(tfm);
+				lrng_drbg_hash_tfm = NULL;
+			} else {
+				pr_info("Hash_DRBG Hashgen with %u lanes "
+					"using %s\n",
+					min_t(u32, lrng_drbg_hash_lanes,
+					      LRNG_DRBG_HASH_LANES_MAX),
+					crypto_tfm_alg_driver_name(
+						crypto_ahash_tfm(tfm)));
+			}
+		}
+	}
+
+	ret = lrng_set_drng_cb(&lrng_drbg_crypto_cb);
+	if (ret && lrng_drbg_hash_tfm) {
+		crypto_free_ahash(lrng_drbg_hash_tfm);
+		lrng_drbg_hash_tfm = NULL;
+	}
+
+	return ret;
 }
 
 static void __exit lrng_drbg_exit(void)
 {
-	lrng_set_drng_cb(NULL);
+	lrng_unset_drng_cb(&lrng_drbg_crypto_cb);
+	if (lrng_drbg_hash_tfm)
+		crypto_free_ahash(lrng_drbg_hash_tfm);
 }
 
 late_initcall(lrng_drbg_init);
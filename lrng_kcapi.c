@@ -23,9 +23,11 @@
 
 #include <crypto/hash.h>
 #include <crypto/rng.h>
+#include <crypto/skcipher.h>
 #include <linux/init.h>
 #include <linux/module.h>
 #include <linux/lrng.h>
+#include <linux/scatterlist.h>
 
 static char *drng_name = NULL;
 module_param(drng_name, charp, 0444);
@@ -36,6 +38,11 @@ module_param(pool_hash, charp, 0444);
 MODULE_PARM_DESC(pool_hash,
 		 "Kernel crypto API name of hash or keyed message digest to read the entropy pool");
 
+static char *drng_skcipher = NULL;
+module_param(drng_skcipher, charp, 0444);
+MODULE_PARM_DESC(drng_skcipher,
+		 "Kernel crypto API name of stream cipher to use as fast-key-erasure DRNG instead of drng_name");
+
 static char *seed_hash = NULL;
 module_param(seed_hash, charp, 0444);
 MODULE_PARM_DESC(seed_hash,
@@ -51,7 +58,8 @@ struct lrng_drng_info {
 	struct lrng_hash_info *lrng_hash;
 };
 
-static struct lrng_hash_info *_lrng_kcapi_hash_alloc(const char *name)
+static struct lrng_hash_info *_lrng_kcapi_hash_alloc(const char *name,
+						     int node)
 {
 	struct lrng_hash_info *lrng_hash;
 	struct crypto_shash *tfm;
@@ -69,7 +77,7 @@ static struct lrng_hash_info *_lrng_kcapi_hash_alloc(const char *name)
 	}
 
 	size = sizeof(struct lrng_hash_info) + crypto_shash_descsize(tfm);
-	lrng_hash = kmalloc(size, GFP_KERNEL);
+	lrng_hash = kmalloc_node(size, GFP_KERNEL, node);
 	if (!lrng_hash) {
 		crypto_free_shash(tfm);
 		return ERR_PTR(-ENOMEM);
@@ -102,7 +110,7 @@ static void *lrng_kcapi_hash_alloc(const u8 *key, u32 keylen)
 	struct lrng_hash_info *lrng_hash;
 	int ret;
 
-	lrng_hash = _lrng_kcapi_hash_alloc(pool_hash);
+	lrng_hash = _lrng_kcapi_hash_alloc(pool_hash, NUMA_NO_NODE);
 	if (IS_ERR(lrng_hash))
 		return ERR_CAST(lrng_hash);
 
@@ -143,12 +151,221 @@ static int lrng_kcapi_hash_buffer(void *hash, const u8 *inbuf, u32 inbuflen,
 	return crypto_shash_digest(shash, inbuf, inbuflen, digest);
 }
 
+/* Default seed hash with a digest size equal to the seed size */
+static const char *lrng_kcapi_seed_hash_name(u32 seedsize)
+{
+	switch (seedsize) {
+	case 32:
+		return "sha256";
+	case 48:
+		return "sha384";
+	case 64:
+		return "sha512";
+	default:
+		return NULL;
+	}
+}
+
+/*
+ * DRNG based on an arbitrary stream cipher of the kernel crypto API, such as
+ * ctr(aes) or xchacha20, using fast key erasure: each block of keystream
+ * generated with the current key starts with the next key which replaces the
+ * current key immediately. The remainder of the block is returned. As every
+ * key is only used once, the IV is always zero. A seed is mixed into the key
+ * with the seed hash: key = Hash(key || seed).
+ */
+#define LRNG_KCAPI_SKCIPHER_BUF	PAGE_SIZE
+
+struct lrng_skcipher_info {
+	struct crypto_skcipher *tfm;
+	struct lrng_hash_info *lrng_hash;	/* Seed hash */
+	u8 *buf;				/* Keystream buffer */
+	u8 *iv;
+	u32 keysize;
+	u8 key[];
+};
+
+static int lrng_skcipher_setkey(struct lrng_skcipher_info *sk, const u8 *key)
+{
+	memcpy(sk->key, key, sk->keysize);
+	return crypto_skcipher_setkey(sk->tfm, sk->key, sk->keysize);
+}
+
+static int lrng_skcipher_seed_helper(void *drng, const u8 *inbuf, u32 inbuflen)
+{
+	struct lrng_skcipher_info *sk = (struct lrng_skcipher_info *)drng;
+	struct lrng_hash_info *lrng_hash = sk->lrng_hash;
+	struct shash_desc *shash = &lrng_hash->shash;
+	u8 digest[64] __aligned(8);
+	int ret;
+
+	ret = crypto_shash_init(shash);
+	if (ret)
+		return ret;
+
+	ret = crypto_shash_update(shash, sk->key, sk->keysize);
+	if (ret)
+		return ret;
+
+	ret = crypto_shash_finup(shash, inbuf, inbuflen, digest);
+	if (!ret)
+		ret = lrng_skcipher_setkey(sk, digest);
+
+	memzero_explicit(digest, sizeof(digest));
+	return ret;
+}
+
+static int lrng_skcipher_generate_helper(void *drng, u8 *outbuf,
+					 u32 outbuflen)
+{
+	struct lrng_skcipher_info *sk = (struct lrng_skcipher_info *)drng;
+	struct skcipher_request *req;
+	struct scatterlist sg;
+	DECLARE_CRYPTO_WAIT(wait);
+	u32 processed = 0;
+	int ret = 0;
+
+	req = skcipher_request_alloc(sk->tfm, GFP_KERNEL);
+	if (!req)
+		return -ENOMEM;
+	skcipher_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG |
+					   CRYPTO_TFM_REQ_MAY_SLEEP,
+				      crypto_req_done, &wait);
+
+	while (processed < outbuflen) {
+		u32 todo = min_t(u32, outbuflen - processed,
+				 LRNG_KCAPI_SKCIPHER_BUF - sk->keysize);
+
+		memset(sk->buf, 0, todo + sk->keysize);
+		memset(sk->iv, 0, crypto_skcipher_ivsize(sk->tfm));
+		sg_init_one(&sg, sk->buf, todo + sk->keysize);
+		skcipher_request_set_crypt(req, &sg, &sg, todo + sk->keysize,
+					   sk->iv);
+		ret = crypto_wait_req(crypto_skcipher_encrypt(req), &wait);
+		if (ret)
+			break;
+
+		/* Fast key erasure: replace the key before returning data */
+		ret = lrng_skcipher_setkey(sk, sk->buf);
+		if (ret)
+			break;
+
+		memcpy(outbuf + processed, sk->buf + sk->keysize, todo);
+		processed += todo;
+	}
+
+	memzero_explicit(sk->buf, LRNG_KCAPI_SKCIPHER_BUF);
+	skcipher_request_free(req);
+
+	return ret ? ret : outbuflen;
+}
+
+static void lrng_skcipher_dealloc(void *drng)
+{
+	struct lrng_skcipher_info *sk = (struct lrng_skcipher_info *)drng;
+
+	if (sk->lrng_hash)
+		_lrng_kcapi_hash_free(sk->lrng_hash);
+	crypto_free_skcipher(sk->tfm);
+	kzfree(sk->buf);
+	kzfree(sk->iv);
+	kzfree(sk);
+	pr_info("Stream cipher DRNG %s deallocated\n", drng_skcipher);
+}
+
+static void *lrng_skcipher_alloc(u32 sec_strength, int node)
+{
+	struct lrng_skcipher_info *sk;
+	struct crypto_skcipher *tfm;
+	const char *hash_name;
+	void *ret = ERR_PTR(-ENOMEM);
+	u32 keysize;
+
+	tfm = crypto_alloc_skcipher(drng_skcipher, 0, 0);
+	if (IS_ERR(tfm)) {
+		pr_err("stream cipher %s cannot be allocated\n",
+		       drng_skcipher);
+		return ERR_CAST(tfm);
+	}
+
+	if (crypto_skcipher_blocksize(tfm) != 1) {
+		pr_err("%s is no stream cipher\n", drng_skcipher);
+		ret = ERR_PTR(-EINVAL);
+		goto free_tfm;
+	}
+
+	keysize = crypto_skcipher_max_keysize(tfm);
+	if (sec_strength > keysize)
+		pr_info("Key size of stream cipher (%u bits) lower than "
+			"security strength of LRNG noise source (%u bits)\n",
+			keysize * 8, sec_strength * 8);
+
+	sk = kzalloc_node(sizeof(*sk) + keysize, GFP_KERNEL, node);
+	if (!sk)
+		goto free_tfm;
+	sk->tfm = tfm;
+	sk->keysize = keysize;
+
+	sk->buf = kmalloc_node(LRNG_KCAPI_SKCIPHER_BUF, GFP_KERNEL, node);
+	sk->iv = kzalloc_node(max_t(u32, crypto_skcipher_ivsize(tfm), 1),
+			      GFP_KERNEL, node);
+	if (!sk->buf || !sk->iv)
+		goto free;
+
+	hash_name = seed_hash ? seed_hash : lrng_kcapi_seed_hash_name(keysize);
+	if (!hash_name) {
+		pr_err("Key size %u cannot be processed\n", keysize);
+		ret = ERR_PTR(-EINVAL);
+		goto free;
+	}
+	sk->lrng_hash = _lrng_kcapi_hash_alloc(hash_name, node);
+	if (IS_ERR(sk->lrng_hash)) {
+		ret = ERR_CAST(sk->lrng_hash);
+		sk->lrng_hash = NULL;
+		goto free;
+	}
+	if (keysize != _lrng_kcapi_hash_digestsize(sk->lrng_hash)) {
+		pr_err("Seed hash output size not equal to stream cipher key "
+		       "size\n");
+		ret = ERR_PTR(-EINVAL);
+		goto free;
+	}
+	/* The LRNG seeds the DRNG before use */
+	if (crypto_skcipher_setkey(tfm, sk->key, keysize)) {
+		ret = ERR_PTR(-EINVAL);
+		goto free;
+	}
+
+	pr_info("Stream cipher DRNG %s (%s) with seed hash %s allocated\n",
+		drng_skcipher,
+		crypto_tfm_alg_driver_name(crypto_skcipher_tfm(tfm)),
+		hash_name);
+
+	return sk;
+
+free:
+	if (sk->lrng_hash)
+		_lrng_kcapi_hash_free(sk->lrng_hash);
+	kfree(sk->buf);
+	kfree(sk->iv);
+	kfree(sk);
+free_tfm:
+	crypto_free_skcipher(tfm);
+	return ret;
+}
+
 static int lrng_kcapi_drng_seed_helper(void *drng, const u8 *inbuf,
 				       u32 inbuflen)
 {
 	struct lrng_drng_info *lrng_drng_info = (struct lrng_drng_info *)drng;
-	struct crypto_rng *kcapi_rng = lrng_drng_info->kcapi_rng;
-	struct lrng_hash_info *lrng_hash = lrng_drng_info->lrng_hash;
+	struct crypto_rng *kcapi_rng;
+	struct lrng_hash_info *lrng_hash;
+
+	if (drng_skcipher)
+		return lrng_skcipher_seed_helper(drng, inbuf, inbuflen);
+
+	kcapi_rng = lrng_drng_info->kcapi_rng;
+	lrng_hash = lrng_drng_info->lrng_hash;
 
 	if (lrng_hash) {
 		struct shash_desc *shash = &lrng_hash->shash;
@@ -178,22 +395,34 @@ static int lrng_kcapi_drng_generate_helper(void *drng, u8 *outbuf,
 					   u32 outbuflen)
 {
 	struct lrng_drng_info *lrng_drng_info = (struct lrng_drng_info *)drng;
-	struct crypto_rng *kcapi_rng = lrng_drng_info->kcapi_rng;
-	int ret = crypto_rng_get_bytes(kcapi_rng, outbuf, outbuflen);
+	int ret;
+
+	if (drng_skcipher)
+		return lrng_skcipher_generate_helper(drng, outbuf, outbuflen);
 
+	ret = crypto_rng_get_bytes(lrng_drng_info->kcapi_rng, outbuf,
+				   outbuflen);
 	if (ret < 0)
 		return ret;
 
 	return outbuflen;
 }
 
-static void *lrng_kcapi_drng_alloc(u32 sec_strength)
+/*
+ * The DRNG handle and the seed hash descriptor are allocated on the requested
+ * NUMA node. The crypto_rng and its context are placed by the default memory
+ * policy on the node the LRNG executes the allocation on.
+ */
+static void *lrng_kcapi_drng_alloc(u32 sec_strength, int node)
 {
 	struct lrng_drng_info *lrng_drng_info;
 	struct crypto_rng *kcapi_rng;
 	int seedsize;
 	void *ret =  ERR_PTR(-ENOMEM);
 
+	if (drng_skcipher)
+		return lrng_skcipher_alloc(sec_strength, node);
+
 	if (!drng_name) {
 		pr_err("DRNG name missing\n");
 		return ERR_PTR(-EINVAL);
@@ -212,7 +441,8 @@ static void *lrng_kcapi_drng_alloc(u32 sec_strength)
 		return ERR_PTR(-EINVAL);
 	}
 
-	lrng_drng_info = kmalloc(sizeof(*lrng_drng_info), GFP_KERNEL);
+	lrng_drng_info = kmalloc_node(sizeof(*lrng_drng_info), GFP_KERNEL,
+				      node);
 	if (!lrng_drng_info)
 		return ERR_PTR(-ENOMEM);
 
@@ -236,25 +466,15 @@ static void *lrng_kcapi_drng_alloc(u32 sec_strength)
 		struct lrng_hash_info *lrng_hash;
 
 		if (!seed_hash) {
-			switch (seedsize) {
-			case 32:
-				seed_hash = "sha256";
-				break;
-			case 48:
-				seed_hash = "sha384";
-				break;
-			case 64:
-				seed_hash = "sha512";
-				break;
-			default:
+			seed_hash = (char *)lrng_kcapi_seed_hash_name(seedsize);
+			if (!seed_hash) {
 				pr_err("Seed size %d cannot be processed\n",
 				       seedsize);
 				goto dealloc;
-				break;
 			}
 		}
 
-		lrng_hash = _lrng_kcapi_hash_alloc(seed_hash);
+		lrng_hash = _lrng_kcapi_hash_alloc(seed_hash, node);
 		if (IS_ERR(lrng_hash)) {
 			ret = ERR_CAST(lrng_hash);
 			goto dealloc;
@@ -289,10 +509,15 @@ free:
 static void lrng_kcapi_drng_dealloc(void *drng)
 {
 	struct lrng_drng_info *lrng_drng_info = (struct lrng_drng_info *)drng;
-	struct crypto_rng *kcapi_rng = lrng_drng_info->kcapi_rng;
-	struct lrng_hash_info *lrng_hash = lrng_drng_info->lrng_hash;
+	struct lrng_hash_info *lrng_hash;
 
-	crypto_free_rng(kcapi_rng);
+	if (drng_skcipher) {
+		lrng_skcipher_dealloc(drng);
+		return;
+	}
+
+	crypto_free_rng(lrng_drng_info->kcapi_rng);
+	lrng_hash = lrng_drng_info->lrng_hash;
 	if (lrng_hash) {
 		_lrng_kcapi_hash_free(lrng_hash);
 		pr_info("Seed hash %s deallocated\n", seed_hash);
@@ -303,7 +528,7 @@ static void lrng_kcapi_drng_dealloc(void *drng)
 
 static const char *lrng_kcapi_drng_name(void)
 {
-	return drng_name;
+	return drng_skcipher ? drng_skcipher : drng_name;
 }
 
 static const char *lrng_kcapi_pool_hash(void)
@@ -311,6 +536,16 @@ static const char *lrng_kcapi_pool_hash(void)
 	return pool_hash;
 }
 
+/*
+ * The stream cipher DRNG amortizes the per-call request setup over 64 kB.
+ * The skcipher implementation selected by priority for a stream cipher is
+ * typically a SIMD one, thus the stream cipher DRNG is marked to use the FPU.
+ */
+static struct lrng_drng_caps lrng_kcapi_caps = {
+	.version	= LRNG_DRNG_CAPS_VERSION,
+	.flags		= LRNG_DRNG_CAP_PARALLEL,
+};
+
 const static struct lrng_crypto_cb lrng_kcapi_crypto_cb = {
 	.lrng_drng_name			= lrng_kcapi_drng_name,
 	.lrng_hash_name			= lrng_kcapi_pool_hash,
@@ -319,6 +554,7 @@ const static struct lrng_crypto_cb lrng_kcapi_crypto_cb = {
 	.lrng_drng_seed_helper		= lrng_kcapi_drng_seed_helper,
 	.lrng_drng_generate_helper	= lrng_kcapi_drng_generate_helper,
 	.lrng_drng_generate_helper_full	= lrng_kcapi_drng_generate_helper,
+	.lrng_drng_caps			= &lrng_kcapi_caps,
 	.lrng_hash_alloc		= lrng_kcapi_hash_alloc,
 	.lrng_hash_dealloc		= lrng_kcapi_hash_dealloc,
 	.lrng_hash_digestsize		= lrng_kcapi_hash_digestsize,
@@ -327,11 +563,16 @@ const static struct lrng_crypto_cb lrng_kcapi_crypto_cb = {
 
 static int __init lrng_kcapi_init(void)
 {
+	if (drng_skcipher) {
+		lrng_kcapi_caps.max_reqsize = 1 << 16;
+		lrng_kcapi_caps.flags |= LRNG_DRNG_CAP_FPU;
+	}
+
 	return lrng_set_drng_cb(&lrng_kcapi_crypto_cb);
 }
 static void __exit lrng_kcapi_exit(void)
 {
-	lrng_set_drng_cb(NULL);
+	lrng_unset_drng_cb(&lrng_kcapi_crypto_cb);
 }
 
 late_initcall(lrng_kcapi_init);
@@ -0,0 +1,59 @@
+#!/bin/bash
+#
+# Copyright (C) 2019, Stephan Mueller <smueller@chronox.de>
+#
+# Test for analyzing the time until the primary DRNG is minimally seeded
+# during boot by power cycling the test machine many times and recording the
+# kernel time stamps of the seeding events.
+#
+# Each line in $OUTFILE holds the time in seconds since kernel start when
+#	1. the boot loader seed was injected (or - if none was provided)
+#	2. the primary DRNG was minimally seeded -- a primary DRNG seeded with
+#	   full security strength at once, e.g. with a fully credited boot
+#	   loader seed, reports only being fully seeded, thus that time is
+#	   recorded
+#	3. the primary DRNG was fully seeded (or - if not reached before test)
+#
+# Compare boots with and without boot loader seed and with different values
+# of lrng_base.bootloader_seed_credit / random.trust_bootloader.
+#
+# Test execution:
+#	1. Boot the kernel with printk.time=1 (or CONFIG_PRINTK_TIME)
+#	2. Copy this file to /usr/local/sbin and make it executable and do not
+#	   forget restorecon if applicable
+#	3. Copy boottime_test_record.service to /etc/systemd/system/ and
+#	   point ExecStart to this file
+#	4. systemctl enable boottime_test_record
+#	5. reboot and wait until reboot test completes
+#	6. Pick up $OUTFILE and analyze
+#
+# Test interruption:
+#	boot with kernel command line option of boottime_test_stop
+#
+OUTFILE="/home/sm/boottime_seed.out"
+TESTS=1000
+
+event_time()
+{
+	local ts=$(dmesg | grep -E "$1" | head -n 1 | sed -e 's/^\[ *\([0-9.]*\)\].*/\1/')
+
+	if [ -z "$ts" ]; then
+		echo "-"
+	else
+		echo "$ts"
+	fi
+}
+
+echo "$(event_time "boot loader seed") $(event_time "primary DRNG (minimally|fully) seeded") $(event_time "primary DRNG fully seeded")" >> $OUTFILE
+testruns=$(wc -l $OUTFILE | cut -d" " -f1)
+
+if [ $testruns -gt $TESTS ]; then
+	systemctl stop boottime_test_record
+	systemctl disable boottime_test_record
+fi
+
+if (cat /proc/cmdline | grep -q boottime_test_stop) ; then
+	exit 0
+fi
+
+reboot
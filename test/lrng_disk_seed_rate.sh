@@ -0,0 +1,101 @@
+#!/bin/bash
+#
+# Copyright (C) 2019, Stephan Mueller <smueller@chronox.de>
+#
+# License: see LICENSE file in root directory
+#
+# THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+# WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+# OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+# WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+# OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+# BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+# LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+# USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+# DAMAGE.
+#
+# Measure the seeding rate of the block device noise source with polled I/O.
+#
+# blk-mq reports all request completions to the LRNG, but only completions
+# reaped in process context are credited: IRQ-driven completions are already
+# credited as interrupts. The test therefore reads from an NVMe namespace with
+# polled I/O (fio io_uring engine with hipri) which completes the requests in
+# the context of the fio threads. It reports the block device time stamps and
+# credited events as well as the number of primary DRNG seeds obtained during
+# the fio run.
+#
+# The test requires fio with io_uring support and an NVMe namespace with poll
+# queues (nvme.poll_queues > 0). The namespace is only read.
+#
+# Usage: lrng_disk_seed_rate.sh <NVMe namespace, e.g. nvme0n1>
+#
+
+EXECTIME=30
+LRNG_TYPE="/proc/sys/kernel/random/lrng_type"
+DISK=$1
+
+if [ $(id -u) -ne 0 ]
+then
+	echo "Test must be run as root"
+	exit 1
+fi
+
+if ! command -v fio > /dev/null 2>&1
+then
+	echo "Tool fio missing"
+	exit 1
+fi
+
+if [ ! -f $LRNG_TYPE ]
+then
+	echo "LRNG not present"
+	exit 1
+fi
+
+if [ -z "$DISK" ] || [ ! -b "/dev/$DISK" ]
+then
+	echo "Usage: $0 <NVMe namespace, e.g. nvme0n1>"
+	exit 1
+fi
+
+lrng_value()
+{
+	grep "$1" $LRNG_TYPE | cut -d ":" -f 2 | cut -d "," -f 1
+}
+
+disk_events()
+{
+	grep "block device time stamps" $LRNG_TYPE | cut -d ":" -f 3
+}
+
+QUEUE="/sys/block/$DISK/queue"
+old_add_random=$(cat $QUEUE/add_random)
+old_io_poll=$(cat $QUEUE/io_poll)
+echo 1 > $QUEUE/add_random
+if ! echo 1 > $QUEUE/io_poll 2>/dev/null
+then
+	echo "$DISK does not support polling, load nvme with poll_queues > 0"
+	echo $old_add_random > $QUEUE/add_random
+	exit 1
+fi
+
+samples=$(lrng_value "block device time stamps")
+events=$(disk_events)
+seeds=$(lrng_value "seeds from primary DRNG")
+
+fio --name=poll --filename=/dev/$DISK --ioengine=io_uring --hipri \
+    --iodepth=16 --direct=1 --readonly --rw=randread --bs=4k --time_based \
+    --runtime=$EXECTIME --numjobs=4 --group_reporting > /dev/null
+
+samples=$(($(lrng_value "block device time stamps") - $samples))
+events=$(($(disk_events) - $events))
+seeds=$(($(lrng_value "seeds from primary DRNG") - $seeds))
+
+echo $old_io_poll > $QUEUE/io_poll
+echo $old_add_random > $QUEUE/add_random
+
+echo -e "Time stamps/s\tCredited events/s\tPrimary DRNG seeds"
+echo -e "$(($samples / $EXECTIME))\t$(($events / $EXECTIME))\t$seeds"
@@ -0,0 +1,77 @@
+#!/bin/bash
+#
+# Copyright (C) 2019, Stephan Mueller <smueller@chronox.de>
+#
+# License: see LICENSE file in root directory
+#
+# THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+# WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+# OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+# WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+# OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+# BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+# LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+# USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+# DAMAGE.
+#
+# Measure the speed of the secondary DRNG of each NUMA node together with
+# the node-local and remote memory accesses caused by the generation.
+#
+# The test requires numactl and perf. The speedtest is pinned to the CPUs and
+# memory of one node at a time. The kernel-side memory accesses are counted
+# with the node-loads / node-load-misses events where node-load-misses
+# are loads served from a remote node.
+#
+
+SPEED="./speedtest"
+BLOCKSIZE=4096
+EXECTIME=5
+
+if [ $(id -u) -ne 0 ]
+then
+	echo "Test must be run as root"
+	exit 1
+fi
+
+if [ ! -x "$SPEED" ]
+then
+	echo "Compile speedtest first"
+	exit 1
+fi
+
+for tool in numactl perf
+do
+	if ! command -v $tool > /dev/null 2>&1
+	then
+		echo "Tool $tool missing"
+		exit 1
+	fi
+done
+
+if [ -f /proc/sys/kernel/random/lrng_type ]
+then
+	cat /proc/sys/kernel/random/lrng_type
+	echo
+fi
+
+echo -e "Node\tSpeed\tNode loads\tRemote node loads"
+
+for node in $(ls -d /sys/devices/system/node/node* | sed 's/.*node//')
+do
+	if [ -z "$(cat /sys/devices/system/node/node$node/cpulist)" ]
+	then
+		continue
+	fi
+
+	result=$(perf stat -x "," -e node-loads:k,node-load-misses:k \
+		 numactl --cpunodebind=$node --membind=$node \
+		 $SPEED -e $EXECTIME -b $BLOCKSIZE 2>&1)
+	speed=$(echo "$result" | grep "|" | cut -d "|" -f 2)
+	loads=$(echo "$result" | grep "node-loads" | cut -d "," -f 1)
+	misses=$(echo "$result" | grep "node-load-misses" | cut -d "," -f 1)
+
+	echo -e "$node\t$speed\t$loads\t$misses"
+done
@@ -0,0 +1,75 @@
+#!/bin/bash
+#
+# Copyright (C) 2019, Stephan Mueller <smueller@chronox.de>
+#
+# License: see LICENSE file in root directory
+#
+# THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+# WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+# OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+# WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+# OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+# BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+# LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+# USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+# DAMAGE.
+#
+# Test that the context switch noise source credits entropy.
+#
+# The kernel must be booted with lrng_base.sched_noise=1. The test causes
+# context switches by passing data between two processes through a pipe
+# and verifies that both the number of context switch time stamps and the
+# number of events credited as interrupts increase. The default oversampling
+# of 32 exceeds the batch size of 16 time stamps, so credited events show
+# that non-stuck time stamps are carried over between batches.
+#
+
+EXECTIME=5
+LRNG_TYPE="/proc/sys/kernel/random/lrng_type"
+SCHED_NOISE="/sys/module/lrng_base/parameters/sched_noise"
+
+if [ ! -f $LRNG_TYPE ]
+then
+	echo "LRNG not present"
+	exit 1
+fi
+
+if [ ! -f $SCHED_NOISE ] || [ "$(cat $SCHED_NOISE)" != "Y" ]
+then
+	echo "Boot with lrng_base.sched_noise=1"
+	exit 1
+fi
+
+sched_value()
+{
+	grep "context switch time stamps" $LRNG_TYPE | cut -d ":" -f $1 | \
+		cut -d "," -f 1
+}
+
+samples=$(sched_value 2)
+events=$(sched_value 3)
+
+timeout $EXECTIME bash -c 'while true; do echo; done' | \
+	timeout $EXECTIME bash -c 'while read line; do :; done'
+
+samples=$(($(sched_value 2) - $samples))
+events=$(($(sched_value 3) - $events))
+
+echo "Context switch time stamps: $samples, credited events: $events"
+
+if [ $samples -le 0 ]
+then
+	echo "FAIL: no context switch time stamps collected"
+	exit 1
+fi
+
+if [ $events -le 0 ]
+then
+	echo "FAIL: no events credited (high-resolution timer present?)"
+	exit 1
+fi
+
+echo "PASS"
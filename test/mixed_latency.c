@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2019, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/*
+ * Mixed workload: one streaming reader obtains large blocks from getrandom
+ * while a number of readers request small blocks. The latency distribution
+ * of the small requests is reported. To measure the contention on one
+ * secondary DRNG, bind the test to the CPUs of one NUMA node, e.g.:
+ *
+ * numactl --cpunodebind=0 ./mixed_latency -t 8
+ *
+ * Compile:
+ * gcc -Wall -pedantic -Wextra -o mixed_latency mixed_latency.c -lpthread
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/random.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+struct opts {
+	uint64_t exectime;
+	size_t streamlen;
+	size_t smalllen;
+	unsigned int threads;
+};
+
+struct small_reader {
+	pthread_t thread;
+	const struct opts *opts;
+	uint64_t *lat;
+	size_t nlat;
+	size_t maxlat;
+	int ret;
+};
+
+static volatile int stop;
+
+static inline uint64_t ts2u64(struct timespec *ts)
+{
+	return (uint64_t)((uint64_t)ts->tv_sec * 1000000000 +
+			  (uint64_t)ts->tv_nsec);
+}
+
+static inline uint64_t get_nstime(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts2u64(&ts);
+}
+
+static void *streamer(void *arg)
+{
+	const struct opts *opts = arg;
+	uint8_t *buffer = malloc(opts->streamlen);
+
+	if (!buffer)
+		return NULL;
+
+	while (!stop) {
+		if (getrandom(buffer, opts->streamlen, 0) < 0)
+			break;
+	}
+
+	free(buffer);
+	return NULL;
+}
+
+static void *small(void *arg)
+{
+	struct small_reader *reader = arg;
+	uint8_t *buffer = malloc(reader->opts->smalllen);
+
+	if (!buffer) {
+		reader->ret = -ENOMEM;
+		return NULL;
+	}
+
+	while (!stop) {
+		uint64_t start, end;
+
+		start = get_nstime();
+		if (getrandom(buffer, reader->opts->smalllen, 0) < 0) {
+			reader->ret = -errno;
+			break;
+		}
+		end = get_nstime();
+
+		if (reader->nlat >= reader->maxlat) {
+			size_t maxlat = reader->maxlat * 2;
+			uint64_t *lat = realloc(reader->lat,
+						maxlat * sizeof(*lat));
+
+			if (!lat) {
+				reader->ret = -ENOMEM;
+				break;
+			}
+			reader->lat = lat;
+			reader->maxlat = maxlat;
+		}
+		reader->lat[reader->nlat++] = end - start;
+	}
+
+	free(buffer);
+	return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static uint64_t percentile(uint64_t *lat, size_t nlat, unsigned int pct)
+{
+	size_t idx = (nlat * pct) / 100;
+
+	if (idx >= nlat)
+		idx = nlat - 1;
+	return lat[idx];
+}
+
+static int mixed_latency(struct opts *opts)
+{
+	struct small_reader *readers;
+	pthread_t stream_thread;
+	uint64_t *lat = NULL;
+	size_t nlat = 0;
+	unsigned int i;
+	int ret = 0;
+
+	readers = calloc(opts->threads, sizeof(*readers));
+	if (!readers)
+		return -ENOMEM;
+
+	if (opts->streamlen &&
+	    pthread_create(&stream_thread, NULL, streamer, opts)) {
+		free(readers);
+		return -EFAULT;
+	}
+
+	for (i = 0; i < opts->threads; i++) {
+		readers[i].opts = opts;
+		readers[i].maxlat = 1024;
+		readers[i].lat = malloc(readers[i].maxlat * sizeof(uint64_t));
+		if (!readers[i].lat ||
+		    pthread_create(&readers[i].thread, NULL, small,
+				   &readers[i])) {
+			ret = -EFAULT;
+			break;
+		}
+	}
+
+	if (!ret)
+		sleep(opts->exectime);
+	stop = 1;
+
+	if (opts->streamlen)
+		pthread_join(stream_thread, NULL);
+	while (i--) {
+		pthread_join(readers[i].thread, NULL);
+		if (readers[i].ret)
+			ret = readers[i].ret;
+		nlat += readers[i].nlat;
+	}
+	if (ret)
+		goto out;
+
+	lat = malloc(nlat * sizeof(*lat));
+	if (!lat) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	for (i = 0, nlat = 0; i < opts->threads; i++) {
+		memcpy(lat + nlat, readers[i].lat,
+		       readers[i].nlat * sizeof(*lat));
+		nlat += readers[i].nlat;
+	}
+	if (!nlat)
+		goto out;
+
+	qsort(lat, nlat, sizeof(*lat), cmp_u64);
+
+	printf("stream %8zu bytes | small %4zu bytes | %10zu requests | "
+	       "p50 %8lu ns | p99 %8lu ns | max %10lu ns\n",
+	       opts->streamlen, opts->smalllen, nlat,
+	       percentile(lat, nlat, 50), percentile(lat, nlat, 99),
+	       lat[nlat - 1]);
+
+out:
+	for (i = 0; i < opts->threads; i++)
+		free(readers[i].lat);
+	free(readers);
+	free(lat);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	struct opts opts;
+	int c = 0;
+
+	opts.exectime = 5;
+	opts.streamlen = 1<<20;
+	opts.smalllen = 32;
+	opts.threads = 4;
+
+	while (1)
+	{
+		int opt_index = 0;
+		static struct option options[] =
+		{
+			{"exectime", 1, 0, 'e'},
+			{"streamlen", 1, 0, 'b'},
+			{"smalllen", 1, 0, 's'},
+			{"threads", 1, 0, 't'},
+			{0, 0, 0, 0}
+		};
+		c = getopt_long(argc, argv, "e:b:s:t:", options, &opt_index);
+		if(-1 == c)
+			break;
+		switch (c)
+		{
+			case 'e':
+				opts.exectime = strtoul(optarg, NULL, 10);
+				if (opts.exectime == ULONG_MAX)
+					return -EINVAL;
+				break;
+			case 'b':
+				opts.streamlen = strtoul(optarg, NULL, 10);
+				break;
+			case 's':
+				opts.smalllen = strtoul(optarg, NULL, 10);
+				if (!opts.smalllen)
+					return -EINVAL;
+				break;
+			case 't':
+				opts.threads = strtoul(optarg, NULL, 10);
+				if (!opts.threads)
+					return -EINVAL;
+				break;
+			default:
+				return -EINVAL;
+		}
+	}
+
+	/* Baseline without streaming reader followed by the mixed workload */
+	if (opts.streamlen) {
+		size_t streamlen = opts.streamlen;
+		int ret;
+
+		opts.streamlen = 0;
+		ret = mixed_latency(&opts);
+		if (ret)
+			return ret;
+		stop = 0;
+		opts.streamlen = streamlen;
+	}
+
+	return mixed_latency(&opts);
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2019, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/*
+ * Hand over a seed file with the RNDSEEDFILE ioctl: the seed file is injected
+ * into the LRNG and replaced with the seed returned by the kernel. With -t,
+ * the ioctl is exercised without touching a file: a seed is injected twice
+ * and the test verifies that the replacement seeds differ from the input and
+ * from each other and that only the first injection is credited (the
+ * seedfile_credit module parameter must be set to see any credit).
+ *
+ * Must be executed as root.
+ *
+ * Compile:
+ * gcc -Wall -pedantic -Wextra -o seedfile seedfile.c
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <linux/random.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/random.h>
+#include <unistd.h>
+
+#ifndef RNDSEEDFILE
+#define RNDSEEDFILE	_IOWR('R', 0x08, int [2])
+#endif
+
+#define SEEDFILE_MAX	512
+#define SEEDFILE_SIZE	64
+
+/* Layout of struct rand_pool_info with a seed buffer */
+struct seed {
+	int entropy_count;
+	int buf_size;
+	uint8_t buf[SEEDFILE_MAX];
+};
+
+static int seedfile_ioctl(struct seed *seed, int entropy_bits, int size)
+{
+	int fd, ret = 0;
+
+	fd = open("/dev/urandom", O_RDWR);
+	if (fd < 0)
+		return -errno;
+
+	seed->entropy_count = entropy_bits;
+	seed->buf_size = size;
+	if (ioctl(fd, RNDSEEDFILE, seed) < 0)
+		ret = -errno;
+
+	close(fd);
+	return ret;
+}
+
+static int seedfile_test(int entropy_bits)
+{
+	struct seed seed, seed2;
+	uint8_t orig[SEEDFILE_SIZE];
+	int ret, credit;
+
+	if (getrandom(orig, sizeof(orig), 0) != sizeof(orig))
+		return -errno;
+
+	memcpy(seed.buf, orig, sizeof(orig));
+	ret = seedfile_ioctl(&seed, entropy_bits, sizeof(orig));
+	if (ret)
+		return ret;
+	credit = seed.entropy_count;
+
+	memcpy(seed2.buf, orig, sizeof(orig));
+	ret = seedfile_ioctl(&seed2, entropy_bits, sizeof(orig));
+	if (ret)
+		return ret;
+
+	printf("credited entropy: %d bits (first), %d bits (replay)\n", credit,
+	       seed2.entropy_count);
+
+	if (!memcmp(seed.buf, orig, sizeof(orig)) ||
+	    !memcmp(seed2.buf, orig, sizeof(orig))) {
+		printf("FAIL: replacement seed equals injected seed\n");
+		return -EINVAL;
+	}
+	if (!memcmp(seed.buf, seed2.buf, sizeof(orig))) {
+		printf("FAIL: replacement seeds are identical\n");
+		return -EINVAL;
+	}
+	if (seed2.entropy_count) {
+		printf("FAIL: replayed seed credited\n");
+		return -EINVAL;
+	}
+	if (credit > entropy_bits) {
+		printf("FAIL: more entropy credited than claimed\n");
+		return -EINVAL;
+	}
+
+	printf("PASS\n");
+	return 0;
+}
+
+static int seedfile_handoff(const char *file, int entropy_bits)
+{
+	struct seed seed;
+	ssize_t size;
+	int fd, ret;
+
+	fd = open(file, O_RDWR);
+	if (fd < 0)
+		return -errno;
+
+	size = read(fd, seed.buf, sizeof(seed.buf));
+	if (size <= 0) {
+		ret = size ? -errno : -EINVAL;
+		goto out;
+	}
+
+	ret = seedfile_ioctl(&seed, entropy_bits, size);
+	if (ret)
+		goto out;
+
+	if (pwrite(fd, seed.buf, size, 0) != size || fsync(fd)) {
+		ret = -errno;
+		goto out;
+	}
+
+	printf("seed file of %zd bytes injected, %d bits of entropy credited\n",
+	       size, seed.entropy_count);
+
+out:
+	memset(&seed, 0, sizeof(seed));
+	close(fd);
+	return ret;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage: seedfile [-e bits] -t|<seed file>\n");
+	fprintf(stderr, "\t-e bits\tentropy claimed for the seed file\n");
+	fprintf(stderr, "\t-t\ttest the ioctl without a seed file\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	int c, ret, entropy_bits = 0, test = 0;
+
+	while ((c = getopt(argc, argv, "e:t")) != -1) {
+		switch (c) {
+		case 'e':
+			entropy_bits = atoi(optarg);
+			break;
+		case 't':
+			test = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+
+	if (test)
+		ret = seedfile_test(entropy_bits);
+	else if (optind < argc)
+		ret = seedfile_handoff(argv[optind], entropy_bits);
+	else
+		usage();
+
+	if (ret)
+		fprintf(stderr, "RNDSEEDFILE failed: %s\n", strerror(-ret));
+
+	return ret ? 1 : 0;
+}